@@ -0,0 +1,338 @@
+/* iobuf.c -- zip IO functions for libKML, written against the minizip
+   ioapi.h interface
+   This IO API version uses a file descriptor behind a large write buffer,
+   the headers patched after their data go out with pwrite
+
+   Copyright (C) 2026  the libKML authors
+*/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "zlib.h"
+#include "ioapi.h"
+#include "iobuf.h"
+
+/* the state of an open file */
+typedef struct ourbuf_s
+{
+    int fd;             /* the file descriptor */
+    char* base;         /* the buffered data */
+    uLong limit;        /* bytes allocated */
+    uLong fill;         /* bytes of buffered data */
+    uLong start;        /* offset in the file of the buffered data */
+    uLong pos;          /* current offset in the file */
+    uLong end;          /* size of the file, buffered data included */
+    int error;          /* errno of the first failed write */
+} ourbuf_t;
+
+voidpf ZCALLBACK buf_open_file_func OF((
+   voidpf opaque,
+   const char* filename,
+   int mode));
+
+uLong ZCALLBACK buf_read_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   void* buf,
+   uLong size));
+
+uLong ZCALLBACK buf_write_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   const void* buf,
+   uLong size));
+
+long ZCALLBACK buf_tell_file_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+long ZCALLBACK buf_seek_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   uLong offset,
+   int origin));
+
+int ZCALLBACK buf_close_file_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+int ZCALLBACK buf_error_file_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+
+/* writes it all at offset, retrying short writes */
+static int buf_pwrite OF((
+   ourbuf_t* ourbuf,
+   const void* buf,
+   uLong size,
+   uLong offset));
+
+static int buf_pwrite (ourbuf, buf, size, offset)
+   ourbuf_t* ourbuf;
+   const void* buf;
+   uLong size;
+   uLong offset;
+{
+    uLong done = 0;
+
+    while (done < size)
+    {
+        ssize_t ret = pwrite(ourbuf->fd, (const char*)buf + done,
+                             (size_t)(size - done), (off_t)(offset + done));
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (ourbuf->error == 0)
+                ourbuf->error = errno;
+            return -1;
+        }
+        done += ret;
+    }
+    return 0;
+}
+
+/* writes out the buffered data, the buffer then starts where it ended */
+static int buf_flush OF((
+   ourbuf_t* ourbuf));
+
+static int buf_flush (ourbuf)
+   ourbuf_t* ourbuf;
+{
+    int ret = 0;
+
+    if (ourbuf->fill > 0)
+        ret = buf_pwrite(ourbuf, ourbuf->base, ourbuf->fill, ourbuf->start);
+
+    ourbuf->start += ourbuf->fill;
+    ourbuf->fill = 0;
+    return ret;
+}
+
+
+voidpf ZCALLBACK buf_open_file_func (opaque, filename, mode)
+   voidpf opaque;
+   const char* filename;
+   int mode;
+{
+    ourbuf_t* ourbuf;
+    uLong limit = IOBUF_SIZE;
+    int flags;
+    off_t end;
+
+    if ((opaque != NULL) && (*(uLong*)opaque > 0))
+        limit = *(uLong*)opaque;
+
+    if ((mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER)==ZLIB_FILEFUNC_MODE_READ)
+        flags = O_RDONLY;
+    else
+    if (mode & ZLIB_FILEFUNC_MODE_EXISTING)
+        flags = O_RDWR;
+    else
+    if (mode & ZLIB_FILEFUNC_MODE_CREATE)
+        flags = O_RDWR | O_CREAT | O_TRUNC;
+    else
+        return NULL;
+
+    if ((filename == NULL) ||
+        ((ourbuf = (ourbuf_t*)calloc(1, sizeof(ourbuf_t))) == NULL))
+        return NULL;
+
+    if ((ourbuf->fd = open(filename, flags | O_CLOEXEC, 0666)) < 0)
+    {
+        free(ourbuf);
+        return NULL;
+    }
+
+    /* files only read need no buffer */
+    if ((flags != O_RDONLY) &&
+        ((ourbuf->base = (char*)malloc(limit)) == NULL))
+    {
+        close(ourbuf->fd);
+        free(ourbuf);
+        return NULL;
+    }
+
+    if ((end = lseek(ourbuf->fd, 0, SEEK_END)) < 0)
+        end = 0;
+
+    ourbuf->limit = limit;
+    ourbuf->end = ourbuf->start = (uLong)end;
+    return ourbuf;
+}
+
+
+uLong ZCALLBACK buf_read_file_func (opaque, stream, buf, size)
+   voidpf opaque;
+   voidpf stream;
+   void* buf;
+   uLong size;
+{
+    ourbuf_t* ourbuf = (ourbuf_t*)stream;
+    ssize_t ret;
+
+    /* reads are rare, they come from the file */
+    if (buf_flush(ourbuf) != 0)
+        return 0;
+
+    do
+        ret = pread(ourbuf->fd, buf, (size_t)size, (off_t)ourbuf->pos);
+    while ((ret < 0) && (errno == EINTR));
+
+    if (ret < 0)
+        return 0;
+
+    ourbuf->pos += ret;
+    return (uLong)ret;
+}
+
+
+uLong ZCALLBACK buf_write_file_func (opaque, stream, buf, size)
+   voidpf opaque;
+   voidpf stream;
+   const void* buf;
+   uLong size;
+{
+    ourbuf_t* ourbuf = (ourbuf_t*)stream;
+
+    if (ourbuf->base == NULL)
+        return 0;
+
+    /* a header patch inside the buffered data */
+    if ((ourbuf->pos >= ourbuf->start) &&
+        (ourbuf->pos + size <= ourbuf->start + ourbuf->fill))
+    {
+        memcpy(ourbuf->base + (ourbuf->pos - ourbuf->start), buf, size);
+    }
+
+    else
+    {
+        /* anywhere else the buffer starts over from there, so a header
+           patch in data already written goes out in one pwrite */
+        if (ourbuf->pos != ourbuf->start + ourbuf->fill)
+        {
+            if (buf_flush(ourbuf) != 0)
+                return 0;
+            ourbuf->start = ourbuf->pos;
+        }
+
+        if (ourbuf->fill + size > ourbuf->limit)
+            if (buf_flush(ourbuf) != 0)
+                return 0;
+
+        /* blocks as big as the buffer skip it */
+        if (size >= ourbuf->limit)
+        {
+            if (buf_pwrite(ourbuf, buf, size, ourbuf->start) != 0)
+                return 0;
+            ourbuf->start += size;
+        }
+        else
+        {
+            memcpy(ourbuf->base + ourbuf->fill, buf, size);
+            ourbuf->fill += size;
+        }
+    }
+
+    ourbuf->pos += size;
+    if (ourbuf->pos > ourbuf->end)
+        ourbuf->end = ourbuf->pos;
+    return size;
+}
+
+long ZCALLBACK buf_tell_file_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+    ourbuf_t* ourbuf = (ourbuf_t*)stream;
+    return (long)ourbuf->pos;
+}
+
+long ZCALLBACK buf_seek_file_func (opaque, stream, offset, origin)
+   voidpf opaque;
+   voidpf stream;
+   uLong offset;
+   int origin;
+{
+    ourbuf_t* ourbuf = (ourbuf_t*)stream;
+    uLong new_pos;
+    switch (origin)
+    {
+    case ZLIB_FILEFUNC_SEEK_CUR :
+        new_pos = ourbuf->pos + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_END :
+        new_pos = ourbuf->end + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_SET :
+        new_pos = offset;
+        break;
+    default: return -1;
+    }
+
+    if (new_pos > ourbuf->end)
+        return -1;
+
+    ourbuf->pos = new_pos;
+    return 0;
+}
+
+int ZCALLBACK buf_close_file_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+    ourbuf_t* ourbuf = (ourbuf_t*)stream;
+    int ret = 0;
+
+    if (buf_flush(ourbuf) != 0)
+        ret = -1;
+
+    if (close(ourbuf->fd) != 0)
+        ret = -1;
+
+    free(ourbuf->base);
+    free(ourbuf);
+    return ret;
+}
+
+int ZCALLBACK buf_error_file_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+    ourbuf_t* ourbuf = (ourbuf_t*)stream;
+    return ourbuf->error;
+}
+
+void fill_buf_filefunc (pzlib_filefunc_def, pbufsize)
+  zlib_filefunc_def* pzlib_filefunc_def;
+  uLong* pbufsize;
+{
+    pzlib_filefunc_def->zopen_file = buf_open_file_func;
+    pzlib_filefunc_def->zread_file = buf_read_file_func;
+    pzlib_filefunc_def->zwrite_file = buf_write_file_func;
+    pzlib_filefunc_def->ztell_file = buf_tell_file_func;
+    pzlib_filefunc_def->zseek_file = buf_seek_file_func;
+    pzlib_filefunc_def->zclose_file = buf_close_file_func;
+    pzlib_filefunc_def->zerror_file = buf_error_file_func;
+    pzlib_filefunc_def->opaque = pbufsize;
+}
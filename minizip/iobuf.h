@@ -0,0 +1,44 @@
+/* iobuf.h -- zip IO functions for libKML, written against the minizip
+   ioapi.h interface
+   This IO API version uses a file descriptor behind a large write buffer,
+   the headers patched after their data go out with pwrite
+
+   Copyright (C) 2026  the libKML authors
+*/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef _ZLIBIOBUF_H
+#define _ZLIBIOBUF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* default size of the write buffer */
+#define IOBUF_SIZE (4 * 1024 * 1024)
+
+/* pbufsize points to the size of the write buffer, it is read when a file
+   is opened. NULL or 0 for IOBUF_SIZE */
+
+void fill_buf_filefunc OF((zlib_filefunc_def* pzlib_filefunc_def,
+                           uLong* pbufsize));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
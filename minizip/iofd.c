@@ -0,0 +1,175 @@
+/* iofd.c -- zip IO functions for libKML, written against the minizip
+   ioapi.h interface
+   This IO API version writes to an already open file descriptor, which
+   may be a pipe or a socket
+
+   Copyright (C) 2026  the libKML authors
+*/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "zlib.h"
+#include "ioapi.h"
+#include "iofd.h"
+
+voidpf ZCALLBACK fd_open_file_func OF((
+   voidpf opaque,
+   const char* filename,
+   int mode));
+
+uLong ZCALLBACK fd_read_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   void* buf,
+   uLong size));
+
+uLong ZCALLBACK fd_write_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   const void* buf,
+   uLong size));
+
+long ZCALLBACK fd_tell_file_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+long ZCALLBACK fd_seek_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   uLong offset,
+   int origin));
+
+int ZCALLBACK fd_close_file_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+int ZCALLBACK fd_error_file_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+
+voidpf ZCALLBACK fd_open_file_func (opaque, filename, mode)
+   voidpf opaque;
+   const char* filename;
+   int mode;
+{
+    ourfd_t* ourfd = (ourfd_t*)opaque;
+
+    /* the filename is ignored, the descriptor is already open */
+    ourfd->pos = 0;
+    return ourfd;
+}
+
+
+uLong ZCALLBACK fd_read_file_func (opaque, stream, buf, size)
+   voidpf opaque;
+   voidpf stream;
+   void* buf;
+   uLong size;
+{
+    ourfd_t* ourfd = (ourfd_t*)stream;
+    ssize_t ret;
+
+    do
+        ret = read(ourfd->fd, buf, (size_t)size);
+    while ((ret < 0) && (errno == EINTR));
+
+    if (ret < 0)
+        return 0;
+
+    ourfd->pos += ret;
+    return (uLong)ret;
+}
+
+
+uLong ZCALLBACK fd_write_file_func (opaque, stream, buf, size)
+   voidpf opaque;
+   voidpf stream;
+   const void* buf;
+   uLong size;
+{
+    ourfd_t* ourfd = (ourfd_t*)stream;
+    uLong done = 0;
+
+    /* pipes and sockets may take less than asked for */
+    while (done < size)
+    {
+        ssize_t ret = write(ourfd->fd, (const char*)buf + done,
+                            (size_t)(size - done));
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        done += ret;
+    }
+
+    ourfd->pos += done;
+    return done;
+}
+
+long ZCALLBACK fd_tell_file_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+    ourfd_t* ourfd = (ourfd_t*)stream;
+    return (long)ourfd->pos;
+}
+
+long ZCALLBACK fd_seek_file_func (opaque, stream, offset, origin)
+   voidpf opaque;
+   voidpf stream;
+   uLong offset;
+   int origin;
+{
+    /* the descriptor may not be seekable */
+    return -1;
+}
+
+int ZCALLBACK fd_close_file_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+    /* the descriptor is left to the caller */
+    return 0;
+}
+
+int ZCALLBACK fd_error_file_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+    return 0;
+}
+
+void fill_fd_filefunc (pzlib_filefunc_def, ourfd)
+  zlib_filefunc_def* pzlib_filefunc_def;
+  ourfd_t* ourfd;
+{
+    pzlib_filefunc_def->zopen_file = fd_open_file_func;
+    pzlib_filefunc_def->zread_file = fd_read_file_func;
+    pzlib_filefunc_def->zwrite_file = fd_write_file_func;
+    pzlib_filefunc_def->ztell_file = fd_tell_file_func;
+    pzlib_filefunc_def->zseek_file = fd_seek_file_func;
+    pzlib_filefunc_def->zclose_file = fd_close_file_func;
+    pzlib_filefunc_def->zerror_file = fd_error_file_func;
+    pzlib_filefunc_def->opaque = ourfd;
+}
@@ -0,0 +1,47 @@
+/* iofd.h -- zip IO functions for libKML, written against the minizip
+   ioapi.h interface
+   This IO API version writes to an already open file descriptor, which
+   may be a pipe or a socket
+
+   Copyright (C) 2026  the libKML authors
+*/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef _ZLIBIOFD_H
+#define _ZLIBIOFD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the descriptor a zip is written to, it is not closed with the zip.
+   seeking is not supported, open the zip with APPEND_STATUS_CREATESTREAM */
+
+typedef struct ourfd_s
+{
+    int fd;             /* the file descriptor */
+    uLong pos;          /* bytes written so far */
+} ourfd_t;
+
+void fill_fd_filefunc OF((zlib_filefunc_def* pzlib_filefunc_def,
+                          ourfd_t* ourfd));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,200 @@
+/* iomem.c -- zip IO functions for libKML, written against the minizip
+   ioapi.h interface
+   This IO API version uses a growable block of memory instead of a file
+
+   Copyright (C) 2026  the libKML authors
+*/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "zlib.h"
+#include "ioapi.h"
+#include "iomem.h"
+
+/* smallest block of memory to grow to */
+#define IOMEM_MINBLOCK (64 * 1024)
+
+voidpf ZCALLBACK mem_open_file_func OF((
+   voidpf opaque,
+   const char* filename,
+   int mode));
+
+uLong ZCALLBACK mem_read_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   void* buf,
+   uLong size));
+
+uLong ZCALLBACK mem_write_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   const void* buf,
+   uLong size));
+
+long ZCALLBACK mem_tell_file_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+long ZCALLBACK mem_seek_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   uLong offset,
+   int origin));
+
+int ZCALLBACK mem_close_file_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+int ZCALLBACK mem_error_file_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+
+voidpf ZCALLBACK mem_open_file_func (opaque, filename, mode)
+   voidpf opaque;
+   const char* filename;
+   int mode;
+{
+    ourmemory_t* mem = (ourmemory_t*)opaque;
+
+    /* the filename is ignored, a created zip starts out empty */
+    if ((mode & ZLIB_FILEFUNC_MODE_CREATE) &&
+        ((mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER)!=ZLIB_FILEFUNC_MODE_READ))
+        mem->size = 0;
+
+    mem->cur_offset = 0;
+    return mem;
+}
+
+
+uLong ZCALLBACK mem_read_file_func (opaque, stream, buf, size)
+   voidpf opaque;
+   voidpf stream;
+   void* buf;
+   uLong size;
+{
+    ourmemory_t* mem = (ourmemory_t*)stream;
+
+    if (size > mem->size - mem->cur_offset)
+        size = mem->size - mem->cur_offset;
+
+    memcpy(buf, mem->base + mem->cur_offset, size);
+    mem->cur_offset += size;
+    return size;
+}
+
+
+uLong ZCALLBACK mem_write_file_func (opaque, stream, buf, size)
+   voidpf opaque;
+   voidpf stream;
+   const void* buf;
+   uLong size;
+{
+    ourmemory_t* mem = (ourmemory_t*)stream;
+
+    /* grow by doubling so appending stays linear */
+    if (mem->cur_offset + size > mem->limit)
+    {
+        uLong limit = mem->limit * 2;
+        char* base;
+
+        if (limit < mem->cur_offset + size)
+            limit = mem->cur_offset + size;
+        if (limit < IOMEM_MINBLOCK)
+            limit = IOMEM_MINBLOCK;
+
+        if ((base = (char*)realloc(mem->base, limit)) == NULL)
+            return 0;
+
+        mem->base = base;
+        mem->limit = limit;
+    }
+
+    memcpy(mem->base + mem->cur_offset, buf, size);
+    mem->cur_offset += size;
+    if (mem->cur_offset > mem->size)
+        mem->size = mem->cur_offset;
+    return size;
+}
+
+long ZCALLBACK mem_tell_file_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+    ourmemory_t* mem = (ourmemory_t*)stream;
+    return (long)mem->cur_offset;
+}
+
+long ZCALLBACK mem_seek_file_func (opaque, stream, offset, origin)
+   voidpf opaque;
+   voidpf stream;
+   uLong offset;
+   int origin;
+{
+    ourmemory_t* mem = (ourmemory_t*)stream;
+    uLong new_pos;
+    switch (origin)
+    {
+    case ZLIB_FILEFUNC_SEEK_CUR :
+        new_pos = mem->cur_offset + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_END :
+        new_pos = mem->size + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_SET :
+        new_pos = offset;
+        break;
+    default: return -1;
+    }
+
+    if (new_pos > mem->size)
+        return -1;
+
+    mem->cur_offset = new_pos;
+    return 0;
+}
+
+int ZCALLBACK mem_close_file_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+    /* the memory is left to the caller */
+    return 0;
+}
+
+int ZCALLBACK mem_error_file_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+    return 0;
+}
+
+void fill_memory_filefunc (pzlib_filefunc_def, ourmem)
+  zlib_filefunc_def* pzlib_filefunc_def;
+  ourmemory_t* ourmem;
+{
+    pzlib_filefunc_def->zopen_file = mem_open_file_func;
+    pzlib_filefunc_def->zread_file = mem_read_file_func;
+    pzlib_filefunc_def->zwrite_file = mem_write_file_func;
+    pzlib_filefunc_def->ztell_file = mem_tell_file_func;
+    pzlib_filefunc_def->zseek_file = mem_seek_file_func;
+    pzlib_filefunc_def->zclose_file = mem_close_file_func;
+    pzlib_filefunc_def->zerror_file = mem_error_file_func;
+    pzlib_filefunc_def->opaque = ourmem;
+}
@@ -0,0 +1,48 @@
+/* iomem.h -- zip IO functions for libKML, written against the minizip
+   ioapi.h interface
+   This IO API version uses a growable block of memory instead of a file
+
+   Copyright (C) 2026  the libKML authors
+*/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef _ZLIBIOMEM_H
+#define _ZLIBIOMEM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the memory a zip is written to, base is realloc()ed as it grows and is
+   left to the caller once the zip is closed */
+
+typedef struct ourmemory_s
+{
+    char* base;         /* the data */
+    uLong size;         /* bytes of data */
+    uLong limit;        /* bytes allocated */
+    uLong cur_offset;   /* current offset in the data */
+} ourmemory_t;
+
+void fill_memory_filefunc OF((zlib_filefunc_def* pzlib_filefunc_def,
+                              ourmemory_t* ourmem));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
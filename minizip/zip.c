@@ -83,31 +83,45 @@ const char zip_copyright[] =
    " zip 1.01 Copyright 1998-2004 Gilles Vollant - http://www.winimage.com/zLibDll";
 
 
-#define SIZEDATA_INDATABLOCK (4096-(4*4))
+/* smallest central dir to grow to, and the room reserved for the name of
+   each entry zipReserveEntries() is told about */
+#define CENTRALDIR_MINSIZE  (64*1024)
+#define CENTRALDIR_NAMEHINT (32)
+
+/* smallest name table, its size is always a power of two */
+#define NAMETABLE_MINSIZE   (64)
 
 #define LOCALHEADERMAGIC    (0x04034b50)
 #define CENTRALHEADERMAGIC  (0x02014b50)
 #define ENDHEADERMAGIC      (0x06054b50)
+#define DESCRIPTORMAGIC     (0x08074b50)
+#define ZIP64ENDHEADERMAGIC (0x06064b50)
+#define ZIP64ENDLOCHEADERMAGIC (0x07064b50)
+
+/* sizes, offsets and counts at these limits need zip64 records */
+#define ZIP64_MAXVALUE      (0xffffffffUL)
+#define ZIP64_MAXENTRY      (0xffff)
 
 #define FLAG_LOCALHEADER_OFFSET (0x06)
 #define CRC_LOCALHEADER_OFFSET  (0x0e)
 
 #define SIZECENTRALHEADER (0x2e) /* 46 */
 
-typedef struct linkedlist_datablock_internal_s
+typedef struct centraldir_data_s
 {
-  struct linkedlist_datablock_internal_s* next_datablock;
-  uLong  avail_in_this_block;
-  uLong  filled_in_this_block;
-  uLong  unused; /* for future use and alignement */
-  unsigned char data[SIZEDATA_INDATABLOCK];
-} linkedlist_datablock_internal;
-
-typedef struct linkedlist_data_s
+    unsigned char* data;    /* the central headers, one after the other */
+    uLong size;             /* bytes of central headers */
+    uLong limit;            /* bytes allocated */
+} centraldir_data;
+
+typedef struct nametable_data_s
 {
-    linkedlist_datablock_internal* first_block;
-    linkedlist_datablock_internal* last_block;
-} linkedlist_data;
+    uLong* slots;           /* offset+1 in the central dir of the header of
+                               each name, 0 for an empty slot */
+    uLong size;             /* number of slots, a power of two */
+    uLong count;            /* number of names in the table */
+    uLong indexed;          /* bytes of the central dir already in the table */
+} nametable_data;
 
 
 typedef struct
@@ -121,6 +135,8 @@ typedef struct
     char* central_header;       /* central header data for the current file */
     uLong size_centralheader;   /* size of the central header for cur file */
     uLong flag;                 /* flag of the file currently writing */
+    int  zip64;                 /* 1 if the local header has a zip64 extra */
+    uLong pos_zip64extrainfo;   /* offset of the sizes in that extra field */
 
     int  method;                /* compression method of file currenty wr.*/
     int  raw;                   /* 1 for directly writing raw data */
@@ -139,13 +155,15 @@ typedef struct
 {
     zlib_filefunc_def z_filefunc;
     voidpf filestream;        /* io structore of the zipfile */
-    linkedlist_data central_dir;/* datablock with central dir in construction*/
+    centraldir_data central_dir;/* central dir in construction */
+    nametable_data names;     /* hash set of the names in the central dir */
     int  in_opened_file_inzip;  /* 1 if a file in the zip is currently writ.*/
     curfile_info ci;            /* info on the file curretly writing */
 
     uLong begin_pos;            /* position of the beginning of the zipfile */
     uLong add_position_when_writting_offset;
     uLong number_entry;
+    int  streaming;             /* 1 to write data descriptors, never seek */
 #ifndef NO_ADDFILEINEXISTINGZIP
     char *globalcomment;
 #endif
@@ -158,95 +176,197 @@ typedef struct
 #include "crypt.h"
 #endif
 
-local linkedlist_datablock_internal* allocate_new_datablock()
+local void init_centraldir(cd)
+    centraldir_data* cd;
 {
-    linkedlist_datablock_internal* ldi;
-    ldi = (linkedlist_datablock_internal*)
-                 ALLOC(sizeof(linkedlist_datablock_internal));
-    if (ldi!=NULL)
-    {
-        ldi->next_datablock = NULL ;
-        ldi->filled_in_this_block = 0 ;
-        ldi->avail_in_this_block = SIZEDATA_INDATABLOCK ;
-    }
-    return ldi;
+    cd->data = NULL;
+    cd->size = cd->limit = 0;
 }
 
-local void free_datablock(ldi)
-    linkedlist_datablock_internal* ldi;
+local void free_centraldir(cd)
+    centraldir_data* cd;
 {
-    while (ldi!=NULL)
-    {
-        linkedlist_datablock_internal* ldinext = ldi->next_datablock;
-        TRYFREE(ldi);
-        ldi = ldinext;
-    }
+    TRYFREE(cd->data);
+    init_centraldir(cd);
 }
 
-local void init_linkedlist(ll)
-    linkedlist_data* ll;
+/* makes room for len more bytes, growing by doubling so adding headers one
+   at a time stays linear */
+local int reserve_centraldir(cd,len)
+    centraldir_data* cd;
+    uLong len;
 {
-    ll->first_block = ll->last_block = NULL;
+    uLong limit;
+    unsigned char* data;
+
+    if (cd->size + len <= cd->limit)
+        return ZIP_OK;
+
+    limit = cd->limit * 2;
+    if (limit < cd->size + len)
+        limit = cd->size + len;
+    if (limit < CENTRALDIR_MINSIZE)
+        limit = CENTRALDIR_MINSIZE;
+
+    if ((data = (unsigned char*)realloc(cd->data,limit)) == NULL)
+        return ZIP_INTERNALERROR;
+
+    cd->data = data;
+    cd->limit = limit;
+    return ZIP_OK;
 }
 
-local void free_linkedlist(ll)
-    linkedlist_data* ll;
+local int add_data_in_centraldir(cd,buf,len)
+    centraldir_data* cd;
+    const void* buf;
+    uLong len;
 {
-    free_datablock(ll->first_block);
-    ll->first_block = ll->last_block = NULL;
+    int err;
+
+    if (cd==NULL)
+        return ZIP_INTERNALERROR;
+
+    if ((err = reserve_centraldir(cd,len)) != ZIP_OK)
+        return err;
+
+    memcpy(cd->data + cd->size,buf,len);
+    cd->size += len;
+    return ZIP_OK;
 }
 
+local void init_nametable(nt)
+    nametable_data* nt;
+{
+    nt->slots = NULL;
+    nt->size = nt->count = nt->indexed = 0;
+}
 
-local int add_data_in_datablock(ll,buf,len)
-    linkedlist_data* ll;
-    const void* buf;
+local void free_nametable(nt)
+    nametable_data* nt;
+{
+    TRYFREE(nt->slots);
+    init_nametable(nt);
+}
+
+/* FNV-1a */
+local uLong hash_name(name,len)
+    const unsigned char* name;
     uLong len;
 {
-    linkedlist_datablock_internal* ldi;
-    const unsigned char* from_copy;
+    uLong h = 2166136261UL;
+    uLong i;
 
-    if (ll==NULL)
-        return ZIP_INTERNALERROR;
+    for (i=0;i<len;i++)
+        h = ((h ^ name[i]) * 16777619UL) & 0xffffffffUL;
+    return h;
+}
+
+/* the name in a central header, and its length */
+local const unsigned char* centraldir_name(cd,offset,plen)
+    const centraldir_data* cd;
+    uLong offset;
+    uLong* plen;
+{
+    const unsigned char* header = cd->data + offset;
 
-    if (ll->last_block == NULL)
+    *plen = header[28] | ((uLong)header[29] << 8);
+    return header + SIZECENTRALHEADER;
+}
+
+/* the slot holding the name, or the empty slot it would go in */
+local uLong* find_in_nametable(nt,cd,name,len)
+    const nametable_data* nt;
+    const centraldir_data* cd;
+    const unsigned char* name;
+    uLong len;
+{
+    uLong mask = nt->size - 1;
+    uLong i = hash_name(name,len) & mask;
+
+    while (nt->slots[i] != 0)
     {
-        ll->first_block = ll->last_block = allocate_new_datablock();
-        if (ll->first_block == NULL)
-            return ZIP_INTERNALERROR;
+        uLong len_slot;
+        const unsigned char* name_slot =
+            centraldir_name(cd,nt->slots[i] - 1,&len_slot);
+
+        if ((len_slot == len) && (memcmp(name_slot,name,len) == 0))
+            break;
+        i = (i + 1) & mask;
     }
+    return &nt->slots[i];
+}
 
-    ldi = ll->last_block;
-    from_copy = (unsigned char*)buf;
+/* keeps the table at most half full for count names */
+local int reserve_nametable(nt,cd,count)
+    nametable_data* nt;
+    const centraldir_data* cd;
+    uLong count;
+{
+    nametable_data grown;
+    uLong i;
 
-    while (len>0)
-    {
-        uInt copy_this;
-        uInt i;
-        unsigned char* to_copy;
+    if ((nt->size != 0) && (count * 2 <= nt->size))
+        return ZIP_OK;
+
+    grown = *nt;
+    grown.size = NAMETABLE_MINSIZE;
+    while (grown.size < count * 2)
+        grown.size *= 2;
 
-        if (ldi->avail_in_this_block==0)
+    if ((grown.slots = (uLong*)calloc(grown.size,sizeof(uLong))) == NULL)
+        return ZIP_INTERNALERROR;
+
+    for (i=0;i<nt->size;i++)
+        if (nt->slots[i] != 0)
         {
-            ldi->next_datablock = allocate_new_datablock();
-            if (ldi->next_datablock == NULL)
-                return ZIP_INTERNALERROR;
-            ldi = ldi->next_datablock ;
-            ll->last_block = ldi;
+            uLong len;
+            const unsigned char* name = centraldir_name(cd,nt->slots[i] - 1,&len);
+            *find_in_nametable(&grown,cd,name,len) = nt->slots[i];
         }
 
-        if (ldi->avail_in_this_block < len)
-            copy_this = (uInt)ldi->avail_in_this_block;
-        else
-            copy_this = (uInt)len;
-
-        to_copy = &(ldi->data[ldi->filled_in_this_block]);
+    TRYFREE(nt->slots);
+    *nt = grown;
+    return ZIP_OK;
+}
 
-        for (i=0;i<copy_this;i++)
-            *(to_copy+i)=*(from_copy+i);
+/* adds the names of the central headers added since the last call, an
+   archive opened with APPEND_STATUS_ADDINZIP is indexed all at once */
+local int index_nametable(nt,cd)
+    nametable_data* nt;
+    const centraldir_data* cd;
+{
+    while (nt->indexed < cd->size)
+    {
+        const unsigned char* header = cd->data + nt->indexed;
+        uLong size_header;
+        uLong len;
+        const unsigned char* name;
+        uLong* slot;
+        int err;
+
+        if ((cd->size - nt->indexed < SIZECENTRALHEADER) ||
+            (header[0] != 0x50) || (header[1] != 0x4b) ||
+            (header[2] != 0x01) || (header[3] != 0x02))
+            return ZIP_BADZIPFILE;
+
+        name = centraldir_name(cd,nt->indexed,&len);
+        size_header = SIZECENTRALHEADER + len +
+                      (header[30] | ((uLong)header[31] << 8)) +
+                      (header[32] | ((uLong)header[33] << 8));
+        if (cd->size - nt->indexed < size_header)
+            return ZIP_BADZIPFILE;
+
+        if ((err = reserve_nametable(nt,cd,nt->count + 1)) != ZIP_OK)
+            return err;
 
-        ldi->filled_in_this_block += copy_this;
-        ldi->avail_in_this_block -= copy_this;
-        from_copy += copy_this ;
-        len -= copy_this;
+        /* a name already there keeps its first header */
+        slot = find_in_nametable(nt,cd,name,len);
+        if (*slot == 0)
+        {
+            *slot = nt->indexed + 1;
+            nt->count++;
+        }
+        nt->indexed += size_header;
     }
     return ZIP_OK;
 }
@@ -269,7 +389,7 @@ local int ziplocal_putValue (pzlib_filefunc_def, filestream, x, nbByte)
     uLong x;
     int nbByte;
 {
-    unsigned char buf[4];
+    unsigned char buf[8];
     int n;
     for (n = 0; n < nbByte; n++)
     {
@@ -426,6 +546,30 @@ local int ziplocal_getLong (pzlib_filefunc_def,filestream,pX)
     return err;
 }
 
+local int ziplocal_getLong64 OF((
+    const zlib_filefunc_def* pzlib_filefunc_def,
+    voidpf filestream,
+    uLong *pX));
+
+local int ziplocal_getLong64 (pzlib_filefunc_def,filestream,pX)
+    const zlib_filefunc_def* pzlib_filefunc_def;
+    voidpf filestream;
+    uLong *pX;
+{
+    uLong low,high;
+    int err = ziplocal_getLong(pzlib_filefunc_def,filestream,&low);
+
+    if (err==ZIP_OK)
+        err = ziplocal_getLong(pzlib_filefunc_def,filestream,&high);
+
+    /* needs a 64 bit long, as the rest of the zip64 code */
+    if (err==ZIP_OK)
+        *pX = low + ((high<<16)<<16);
+    else
+        *pX = 0;
+    return err;
+}
+
 #ifndef BUFREADCOMMENT
 #define BUFREADCOMMENT (0x400)
 #endif
@@ -517,6 +661,8 @@ extern zipFile ZEXPORT zipOpen2 (pathname, append, globalcomment, pzlib_filefunc
                   pathname,
                   (append == APPEND_STATUS_CREATE) ?
                   (ZLIB_FILEFUNC_MODE_READ | ZLIB_FILEFUNC_MODE_WRITE | ZLIB_FILEFUNC_MODE_CREATE) :
+                  (append == APPEND_STATUS_CREATESTREAM) ?
+                  (ZLIB_FILEFUNC_MODE_WRITE | ZLIB_FILEFUNC_MODE_CREATE) :
                     (ZLIB_FILEFUNC_MODE_READ | ZLIB_FILEFUNC_MODE_WRITE | ZLIB_FILEFUNC_MODE_EXISTING));
 
     if (ziinit.filestream == NULL)
@@ -525,8 +671,10 @@ extern zipFile ZEXPORT zipOpen2 (pathname, append, globalcomment, pzlib_filefunc
     ziinit.in_opened_file_inzip = 0;
     ziinit.ci.stream_initialised = 0;
     ziinit.number_entry = 0;
+    ziinit.streaming = (append == APPEND_STATUS_CREATESTREAM);
     ziinit.add_position_when_writting_offset = 0;
-    init_linkedlist(&(ziinit.central_dir));
+    init_centraldir(&(ziinit.central_dir));
+    init_nametable(&(ziinit.names));
 
 
     zi = (zip_internal*)ALLOC(sizeof(zip_internal));
@@ -556,6 +704,7 @@ extern zipFile ZEXPORT zipOpen2 (pathname, append, globalcomment, pzlib_filefunc
                                     the central dir
                                     (same than number_entry on nospan) */
         uLong size_comment;
+        uLong end_pos;              /* start of the end of central dir records */
 
         central_pos = ziplocal_SearchCentralDir(&ziinit.z_filefunc,ziinit.filestream);
         if (central_pos==0)
@@ -603,10 +752,6 @@ extern zipFile ZEXPORT zipOpen2 (pathname, append, globalcomment, pzlib_filefunc
         if (ziplocal_getShort(&ziinit.z_filefunc, ziinit.filestream,&size_comment)!=ZIP_OK)
             err=ZIP_ERRNO;
 
-        if ((central_pos<offset_central_dir+size_central_dir) &&
-            (err==ZIP_OK))
-            err=ZIP_BADZIPFILE;
-
         if (err!=ZIP_OK)
         {
             ZCLOSE(ziinit.z_filefunc, ziinit.filestream);
@@ -623,34 +768,97 @@ extern zipFile ZEXPORT zipOpen2 (pathname, append, globalcomment, pzlib_filefunc
             }
         }
 
-        byte_before_the_zipfile = central_pos -
+        /* a zip64 end of central dir locator just before the end of central
+           dir points to the zip64 record, which has the real values */
+        end_pos = central_pos;
+        if ((central_pos >= 20) &&
+            (ZSEEK(ziinit.z_filefunc, ziinit.filestream,
+                   central_pos - 20,ZLIB_FILEFUNC_SEEK_SET)==0) &&
+            (ziplocal_getLong(&ziinit.z_filefunc, ziinit.filestream,&uL)==ZIP_OK) &&
+            (uL==ZIP64ENDLOCHEADERMAGIC))
+        {
+            /* number of the disk with the zip64 end of central dir */
+            if (ziplocal_getLong(&ziinit.z_filefunc, ziinit.filestream,&number_disk_with_CD)!=ZIP_OK)
+                err=ZIP_ERRNO;
+
+            /* offset of the zip64 end of central dir */
+            if (ziplocal_getLong64(&ziinit.z_filefunc, ziinit.filestream,&end_pos)!=ZIP_OK)
+                err=ZIP_ERRNO;
+
+            if ((err==ZIP_OK) && (number_disk_with_CD!=0))
+                err=ZIP_BADZIPFILE;
+
+            if ((err==ZIP_OK) && (ZSEEK(ziinit.z_filefunc, ziinit.filestream,
+                                        end_pos,ZLIB_FILEFUNC_SEEK_SET)!=0))
+                err=ZIP_ERRNO;
+
+            if ((err==ZIP_OK) &&
+                ((ziplocal_getLong(&ziinit.z_filefunc, ziinit.filestream,&uL)!=ZIP_OK) ||
+                 (uL!=ZIP64ENDHEADERMAGIC)))
+                err=ZIP_BADZIPFILE;
+
+            /* size of the record, version made by and version needed */
+            if ((err==ZIP_OK) &&
+                ((ziplocal_getLong64(&ziinit.z_filefunc, ziinit.filestream,&uL)!=ZIP_OK) ||
+                 (ziplocal_getLong(&ziinit.z_filefunc, ziinit.filestream,&uL)!=ZIP_OK)))
+                err=ZIP_ERRNO;
+
+            /* number of this disk */
+            if ((err==ZIP_OK) && (ziplocal_getLong(&ziinit.z_filefunc, ziinit.filestream,&number_disk)!=ZIP_OK))
+                err=ZIP_ERRNO;
+
+            /* number of the disk with the start of the central directory */
+            if ((err==ZIP_OK) && (ziplocal_getLong(&ziinit.z_filefunc, ziinit.filestream,&number_disk_with_CD)!=ZIP_OK))
+                err=ZIP_ERRNO;
+
+            /* total number of entries in the central dir on this disk */
+            if ((err==ZIP_OK) && (ziplocal_getLong64(&ziinit.z_filefunc, ziinit.filestream,&number_entry)!=ZIP_OK))
+                err=ZIP_ERRNO;
+
+            /* total number of entries in the central dir */
+            if ((err==ZIP_OK) && (ziplocal_getLong64(&ziinit.z_filefunc, ziinit.filestream,&number_entry_CD)!=ZIP_OK))
+                err=ZIP_ERRNO;
+
+            /* size of the central directory */
+            if ((err==ZIP_OK) && (ziplocal_getLong64(&ziinit.z_filefunc, ziinit.filestream,&size_central_dir)!=ZIP_OK))
+                err=ZIP_ERRNO;
+
+            /* offset of start of central directory */
+            if ((err==ZIP_OK) && (ziplocal_getLong64(&ziinit.z_filefunc, ziinit.filestream,&offset_central_dir)!=ZIP_OK))
+                err=ZIP_ERRNO;
+
+            if ((err==ZIP_OK) &&
+                ((number_entry_CD!=number_entry) ||
+                 (number_disk_with_CD!=0) ||
+                 (number_disk!=0)))
+                err=ZIP_BADZIPFILE;
+        }
+
+        if ((end_pos<offset_central_dir+size_central_dir) &&
+            (err==ZIP_OK))
+            err=ZIP_BADZIPFILE;
+
+        byte_before_the_zipfile = end_pos -
                                 (offset_central_dir+size_central_dir);
         ziinit.add_position_when_writting_offset = byte_before_the_zipfile;
 
-        {
-            uLong size_central_dir_to_read = size_central_dir;
-            size_t buf_size = SIZEDATA_INDATABLOCK;
-            void* buf_read = (void*)ALLOC(buf_size);
-            if (ZSEEK(ziinit.z_filefunc, ziinit.filestream,
-                  offset_central_dir + byte_before_the_zipfile,
-                  ZLIB_FILEFUNC_SEEK_SET) != 0)
-                  err=ZIP_ERRNO;
-
-            while ((size_central_dir_to_read>0) && (err==ZIP_OK))
-            {
-                uLong read_this = SIZEDATA_INDATABLOCK;
-                if (read_this > size_central_dir_to_read)
-                    read_this = size_central_dir_to_read;
-                if (ZREAD(ziinit.z_filefunc, ziinit.filestream,buf_read,read_this) != read_this)
-                    err=ZIP_ERRNO;
-
-                if (err==ZIP_OK)
-                    err = add_data_in_datablock(&ziinit.central_dir,buf_read,
-                                                (uLong)read_this);
-                size_central_dir_to_read-=read_this;
-            }
-            TRYFREE(buf_read);
-        }
+        /* the whole central dir is read in one go */
+        if ((err==ZIP_OK) &&
+            (ZSEEK(ziinit.z_filefunc, ziinit.filestream,
+                   offset_central_dir + byte_before_the_zipfile,
+                   ZLIB_FILEFUNC_SEEK_SET) != 0))
+            err=ZIP_ERRNO;
+
+        if (err==ZIP_OK)
+            err = reserve_centraldir(&ziinit.central_dir,size_central_dir);
+
+        if ((err==ZIP_OK) &&
+            (ZREAD(ziinit.z_filefunc, ziinit.filestream,
+                   ziinit.central_dir.data,size_central_dir) != size_central_dir))
+            err=ZIP_ERRNO;
+
+        if (err==ZIP_OK)
+            ziinit.central_dir.size = size_central_dir;
         ziinit.begin_pos = byte_before_the_zipfile;
         ziinit.number_entry = number_entry_CD;
 
@@ -669,7 +877,9 @@ extern zipFile ZEXPORT zipOpen2 (pathname, append, globalcomment, pzlib_filefunc
     {
 #    ifndef NO_ADDFILEINEXISTINGZIP
         TRYFREE(ziinit.globalcomment);
+        free_centraldir(&ziinit.central_dir);
 #    endif /* !NO_ADDFILEINEXISTINGZIP*/
+        ZCLOSE(ziinit.z_filefunc, ziinit.filestream);
         TRYFREE(zi);
         return NULL;
     }
@@ -687,12 +897,33 @@ extern zipFile ZEXPORT zipOpen (pathname, append)
     return zipOpen2(pathname,append,NULL,NULL);
 }
 
-extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
+extern int ZEXPORT zipReserveEntries (file, number_entry)
+    zipFile file;
+    uLong number_entry;
+{
+    zip_internal* zi;
+    int err;
+
+    if (file == NULL)
+        return ZIP_PARAMERROR;
+    zi = (zip_internal*)file;
+
+    err = reserve_centraldir(&zi->central_dir,
+                             number_entry * (SIZECENTRALHEADER + CENTRALDIR_NAMEHINT));
+    if (err==ZIP_OK)
+        err = index_nametable(&zi->names,&zi->central_dir);
+    if (err==ZIP_OK)
+        err = reserve_nametable(&zi->names,&zi->central_dir,
+                                zi->names.count + number_entry);
+    return err;
+}
+
+extern int ZEXPORT zipOpenNewFileInZip4 (file, filename, zipfi,
                                          extrafield_local, size_extrafield_local,
                                          extrafield_global, size_extrafield_global,
                                          comment, method, level, raw,
                                          windowBits, memLevel, strategy,
-                                         password, crcForCrypting)
+                                         password, crcForCrypting, zip64)
     zipFile file;
     const char* filename;
     const zip_fileinfo* zipfi;
@@ -709,6 +940,7 @@ extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
     int strategy;
     const char* password;
     uLong crcForCrypting;
+    int zip64;
 {
     zip_internal* zi;
     uInt size_filename;
@@ -746,6 +978,17 @@ extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
 
     size_filename = (uInt)strlen(filename);
 
+    /* a second entry of the same name would hide the first one */
+    err = index_nametable(&zi->names,&zi->central_dir);
+    if (err==ZIP_OK)
+        err = reserve_nametable(&zi->names,&zi->central_dir,zi->names.count + 1);
+    if ((err==ZIP_OK) &&
+        (*find_in_nametable(&zi->names,&zi->central_dir,
+                            (const unsigned char*)filename,size_filename) != 0))
+        err = ZIP_DUPLICATENAME;
+    if (err!=ZIP_OK)
+        return err;
+
     if (zipfi == NULL)
         zi->ci.dosDate = 0;
     else
@@ -764,8 +1007,12 @@ extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
       zi->ci.flag |= 6;
     if (password != NULL)
       zi->ci.flag |= 1;
+    if (zi->streaming)
+      zi->ci.flag |= 8;
 
     zi->ci.crc32 = 0;
+    zi->ci.zip64 = zip64;
+    zi->ci.pos_zip64extrainfo = 0;
     zi->ci.method = method;
     zi->ci.encrypt = 0;
     zi->ci.stream_initialised = 0;
@@ -819,8 +1066,8 @@ extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
     /* write the local header */
     err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)LOCALHEADERMAGIC,4);
 
-    if (err==ZIP_OK)
-        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)20,2);/* version needed to extract */
+    if (err==ZIP_OK) /* version needed to extract */
+        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)(zip64 ? 45 : 20),2);
     if (err==ZIP_OK)
         err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)zi->ci.flag,2);
 
@@ -832,16 +1079,17 @@ extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
 
     if (err==ZIP_OK)
         err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,4); /* crc 32, unknown */
-    if (err==ZIP_OK)
-        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,4); /* compressed size, unknown */
-    if (err==ZIP_OK)
-        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,4); /* uncompressed size, unknown */
+    if (err==ZIP_OK) /* compressed size, unknown or in the zip64 extra */
+        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)(zip64 ? ZIP64_MAXVALUE : 0),4);
+    if (err==ZIP_OK) /* uncompressed size, unknown or in the zip64 extra */
+        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)(zip64 ? ZIP64_MAXVALUE : 0),4);
 
     if (err==ZIP_OK)
         err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)size_filename,2);
 
     if (err==ZIP_OK)
-        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)size_extrafield_local,2);
+        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,
+                                (uLong)(size_extrafield_local + (zip64 ? 20 : 0)),2);
 
     if ((err==ZIP_OK) && (size_filename>0))
         if (ZWRITE(zi->z_filefunc,zi->filestream,filename,size_filename)!=size_filename)
@@ -852,6 +1100,19 @@ extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
                                                                            !=size_extrafield_local)
                 err = ZIP_ERRNO;
 
+    /* zip64 extra with room for the sizes, filled in when the file is closed */
+    if ((err==ZIP_OK) && (zip64))
+    {
+        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)0x0001,2);
+        if (err==ZIP_OK)
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)16,2);
+        zi->ci.pos_zip64extrainfo = ZTELL(zi->z_filefunc,zi->filestream);
+        if (err==ZIP_OK)
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,8);
+        if (err==ZIP_OK)
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,8);
+    }
+
     zi->ci.stream.avail_in = (uInt)0;
     zi->ci.stream.avail_out = (uInt)Z_BUFSIZE;
     zi->ci.stream.next_out = zi->ci.buffered_data;
@@ -896,6 +1157,37 @@ extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
     return err;
 }
 
+extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
+                                         extrafield_local, size_extrafield_local,
+                                         extrafield_global, size_extrafield_global,
+                                         comment, method, level, raw,
+                                         windowBits, memLevel, strategy,
+                                         password, crcForCrypting)
+    zipFile file;
+    const char* filename;
+    const zip_fileinfo* zipfi;
+    const void* extrafield_local;
+    uInt size_extrafield_local;
+    const void* extrafield_global;
+    uInt size_extrafield_global;
+    const char* comment;
+    int method;
+    int level;
+    int raw;
+    int windowBits;
+    int memLevel;
+    int strategy;
+    const char* password;
+    uLong crcForCrypting;
+{
+    return zipOpenNewFileInZip4 (file, filename, zipfi,
+                                 extrafield_local, size_extrafield_local,
+                                 extrafield_global, size_extrafield_global,
+                                 comment, method, level, raw,
+                                 windowBits, memLevel, strategy,
+                                 password, crcForCrypting, 0);
+}
+
 extern int ZEXPORT zipOpenNewFileInZip2(file, filename, zipfi,
                                         extrafield_local, size_extrafield_local,
                                         extrafield_global, size_extrafield_global,
@@ -980,7 +1272,9 @@ extern int ZEXPORT zipWriteInFileInZip (file, buf, len)
 
     zi->ci.stream.next_in = (void*)buf;
     zi->ci.stream.avail_in = len;
-    zi->ci.crc32 = crc32(zi->ci.crc32,buf,len);
+    /* raw entries are given their crc by zipCloseFileInZipRaw */
+    if (!zi->ci.raw)
+        zi->ci.crc32 = crc32(zi->ci.crc32,buf,len);
 
     while ((err==ZIP_OK) && (zi->ci.stream.avail_in>0))
     {
@@ -1092,12 +1386,87 @@ extern int ZEXPORT zipCloseFileInZipRaw (file, uncompressed_size, crc32)
     ziplocal_putValue_inmemory(zi->ci.central_header+24,
                                 uncompressed_size,4); /*uncompr size*/
 
+    /* sizes that do not fit the local header need its zip64 extra */
+    if ((!zi->ci.zip64) && ((compressed_size >= ZIP64_MAXVALUE) ||
+                            (uncompressed_size >= ZIP64_MAXVALUE)))
+        err = ZIP_PARAMERROR;
+
+    /* anything that does not fit the central header goes in a zip64 extra,
+       added after the other extra fields and before the comment */
     if (err==ZIP_OK)
-        err = add_data_in_datablock(&zi->central_dir,zi->ci.central_header,
+    {
+        uLong pos_local = zi->ci.pos_local_header - zi->add_position_when_writting_offset;
+        char extra64[28];
+        uInt size_extra64 = 4;
+
+        if (uncompressed_size >= ZIP64_MAXVALUE)
+        {
+            ziplocal_putValue_inmemory(extra64+size_extra64,uncompressed_size,8);
+            size_extra64 += 8;
+        }
+        if (compressed_size >= ZIP64_MAXVALUE)
+        {
+            ziplocal_putValue_inmemory(extra64+size_extra64,compressed_size,8);
+            size_extra64 += 8;
+        }
+        if (pos_local >= ZIP64_MAXVALUE)
+        {
+            ziplocal_putValue_inmemory(extra64+size_extra64,pos_local,8);
+            size_extra64 += 8;
+        }
+
+        if (size_extra64 > 4)
+        {
+            uInt size_filename = (uInt)(zi->ci.central_header[28] & 0xff) |
+                                 ((uInt)(zi->ci.central_header[29] & 0xff) << 8);
+            uInt size_extra = (uInt)(zi->ci.central_header[30] & 0xff) |
+                              ((uInt)(zi->ci.central_header[31] & 0xff) << 8);
+            uLong pos_extra64 = SIZECENTRALHEADER + size_filename + size_extra;
+            char* central_header = (char*)realloc(zi->ci.central_header,
+                                          zi->ci.size_centralheader + size_extra64);
+
+            if (central_header == NULL)
+                err = ZIP_INTERNALERROR;
+            else
+            {
+                zi->ci.central_header = central_header;
+                ziplocal_putValue_inmemory(extra64,(uLong)0x0001,2);
+                ziplocal_putValue_inmemory(extra64+2,(uLong)(size_extra64 - 4),2);
+                memmove(central_header + pos_extra64 + size_extra64,
+                        central_header + pos_extra64,
+                        zi->ci.size_centralheader - pos_extra64);
+                memcpy(central_header + pos_extra64,extra64,size_extra64);
+                zi->ci.size_centralheader += size_extra64;
+
+                ziplocal_putValue_inmemory(central_header+6,(uLong)45,2);
+                ziplocal_putValue_inmemory(central_header+30,
+                                           (uLong)(size_extra + size_extra64),2);
+            }
+        }
+    }
+
+    if (err==ZIP_OK)
+        err = add_data_in_centraldir(&zi->central_dir,zi->ci.central_header,
                                        (uLong)zi->ci.size_centralheader);
     free(zi->ci.central_header);
 
-    if (err==ZIP_OK)
+    if ((err==ZIP_OK) && (zi->streaming))
+    {
+        /* no seeking back, the crc and sizes follow the data */
+        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)DESCRIPTORMAGIC,4);
+
+        if (err==ZIP_OK)
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,crc32,4);
+
+        if (err==ZIP_OK) /* the sizes are 8 bytes after a zip64 local header */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,compressed_size,
+                                    zi->ci.zip64 ? 8 : 4);
+
+        if (err==ZIP_OK)
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,uncompressed_size,
+                                    zi->ci.zip64 ? 8 : 4);
+    }
+    else if (err==ZIP_OK)
     {
         long cur_pos_inzip = ZTELL(zi->z_filefunc,zi->filestream);
         if (ZSEEK(zi->z_filefunc,zi->filestream,
@@ -1107,18 +1476,35 @@ extern int ZEXPORT zipCloseFileInZipRaw (file, uncompressed_size, crc32)
         if (err==ZIP_OK)
             err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,crc32,4); /* crc 32, unknown */
 
-        if (err==ZIP_OK) /* compressed size, unknown */
-            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,compressed_size,4);
+        if (zi->ci.zip64)
+        {
+            /* the sizes go in the zip64 extra, the header keeps 0xffffffff */
+            if ((err==ZIP_OK) && (ZSEEK(zi->z_filefunc,zi->filestream,
+                      zi->ci.pos_zip64extrainfo,ZLIB_FILEFUNC_SEEK_SET)!=0))
+                err = ZIP_ERRNO;
 
-        if (err==ZIP_OK) /* uncompressed size, unknown */
-            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,uncompressed_size,4);
+            if (err==ZIP_OK)
+                err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,uncompressed_size,8);
+
+            if (err==ZIP_OK)
+                err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,compressed_size,8);
+        }
+        else
+        {
+            if (err==ZIP_OK) /* compressed size, unknown */
+                err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,compressed_size,4);
+
+            if (err==ZIP_OK) /* uncompressed size, unknown */
+                err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,uncompressed_size,4);
+        }
 
         if (ZSEEK(zi->z_filefunc,zi->filestream,
                   cur_pos_inzip,ZLIB_FILEFUNC_SEEK_SET)!=0)
             err = ZIP_ERRNO;
     }
 
-    zi->number_entry ++;
+    if (err==ZIP_OK)
+        zi->number_entry ++;
     zi->in_opened_file_inzip = 0;
 
     return err;
@@ -1158,22 +1544,65 @@ extern int ZEXPORT zipClose (file, global_comment)
         size_global_comment = (uInt)strlen(global_comment);
 
     centraldir_pos_inzip = ZTELL(zi->z_filefunc,zi->filestream);
-    if (err==ZIP_OK)
+    size_centraldir = zi->central_dir.size;
+    if ((err==ZIP_OK) && (size_centraldir>0))
+        if (ZWRITE(zi->z_filefunc,zi->filestream,
+                   zi->central_dir.data,size_centraldir) != size_centraldir)
+            err = ZIP_ERRNO;
+    free_centraldir(&zi->central_dir);
+    free_nametable(&zi->names);
+
+    /* zip64 end of central dir record and locator, only when needed */
+    if ((err==ZIP_OK) &&
+        ((zi->number_entry >= ZIP64_MAXENTRY) ||
+         (size_centraldir >= ZIP64_MAXVALUE) ||
+         (centraldir_pos_inzip - zi->add_position_when_writting_offset >= ZIP64_MAXVALUE)))
     {
-        linkedlist_datablock_internal* ldi = zi->central_dir.first_block ;
-        while (ldi!=NULL)
-        {
-            if ((err==ZIP_OK) && (ldi->filled_in_this_block>0))
-                if (ZWRITE(zi->z_filefunc,zi->filestream,
-                           ldi->data,ldi->filled_in_this_block)
-                              !=ldi->filled_in_this_block )
-                    err = ZIP_ERRNO;
-
-            size_centraldir += ldi->filled_in_this_block;
-            ldi = ldi->next_datablock;
-        }
+        uLong zip64end_pos_inzip = ZTELL(zi->z_filefunc,zi->filestream);
+
+        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)ZIP64ENDHEADERMAGIC,4);
+
+        if (err==ZIP_OK) /* size of the rest of this record */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)44,8);
+
+        if (err==ZIP_OK) /* version made by */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)45,2);
+
+        if (err==ZIP_OK) /* version needed to extract */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)45,2);
+
+        if (err==ZIP_OK) /* number of this disk */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,4);
+
+        if (err==ZIP_OK) /* number of the disk with the start of the central directory */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,4);
+
+        if (err==ZIP_OK) /* total number of entries in the central dir on this disk */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)zi->number_entry,8);
+
+        if (err==ZIP_OK) /* total number of entries in the central dir */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)zi->number_entry,8);
+
+        if (err==ZIP_OK) /* size of the central directory */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)size_centraldir,8);
+
+        if (err==ZIP_OK) /* offset of start of central directory */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,
+                                    (uLong)(centraldir_pos_inzip - zi->add_position_when_writting_offset),8);
+
+        if (err==ZIP_OK) /* Magic locator */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)ZIP64ENDLOCHEADERMAGIC,4);
+
+        if (err==ZIP_OK) /* number of the disk with the zip64 end of central dir */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,4);
+
+        if (err==ZIP_OK) /* offset of the zip64 end of central dir */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,
+                                    (uLong)(zip64end_pos_inzip - zi->add_position_when_writting_offset),8);
+
+        if (err==ZIP_OK) /* total number of disks */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)1,4);
     }
-    free_datablock(zi->central_dir.first_block);
 
     if (err==ZIP_OK) /* Magic End */
         err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)ENDHEADERMAGIC,4);
@@ -73,6 +73,7 @@ typedef voidp zipFile;
 #define ZIP_PARAMERROR                  (-102)
 #define ZIP_BADZIPFILE                  (-103)
 #define ZIP_INTERNALERROR               (-104)
+#define ZIP_DUPLICATENAME               (-105)
 
 #ifndef DEF_MEM_LEVEL
 #  if MAX_MEM_LEVEL >= 8
@@ -110,6 +111,7 @@ typedef const char* zipcharpc;
 #define APPEND_STATUS_CREATE        (0)
 #define APPEND_STATUS_CREATEAFTER   (1)
 #define APPEND_STATUS_ADDINZIP      (2)
+#define APPEND_STATUS_CREATESTREAM  (3)
 
 extern zipFile ZEXPORT zipOpen OF((const char *pathname, int append));
 /*
@@ -121,6 +123,10 @@ extern zipFile ZEXPORT zipOpen OF((const char *pathname, int append));
          (useful if the file contain a self extractor code)
      if the file pathname exist and append==APPEND_STATUS_ADDINZIP, we will
        add files in existing zip (be sure you don't add file that doesn't exist)
+     if append==APPEND_STATUS_CREATESTREAM, the zip is created but never
+       seeked in, the crc and sizes of each file follow its data in a data
+       descriptor (general purpose flag bit 3). This allows writing to pipes
+       and sockets, the tell function only has to count the bytes written.
      If the zipfile cannot be opened, the return value is NULL.
      Else, the return value is a zipFile Handle, usable with other function
        of this zip package.
@@ -136,6 +142,14 @@ extern zipFile ZEXPORT zipOpen2 OF((const char *pathname,
                                    zipcharpc* globalcomment,
                                    zlib_filefunc_def* pzlib_filefunc_def));
 
+extern int ZEXPORT zipReserveEntries OF((zipFile file,
+                                         uLong number_entry));
+/*
+  Tell the zip how many more entries are going to be added, so the central
+  directory and the table of names used to refuse duplicates are allocated
+  once. It is only a hint, more entries can still be added.
+*/
+
 extern int ZEXPORT zipOpenNewFileInZip OF((zipFile file,
                        const char* filename,
                        const zip_fileinfo* zipfi,
@@ -157,6 +171,7 @@ extern int ZEXPORT zipOpenNewFileInZip OF((zipFile file,
   if comment != NULL, comment contain the comment string
   method contain the compression method (0 for store, Z_DEFLATED for deflate)
   level contain the level of compression (can be Z_DEFAULT_COMPRESSION)
+  returns ZIP_DUPLICATENAME if the zip already has an entry named filename
 */
 
 
@@ -200,6 +215,34 @@ extern int ZEXPORT zipOpenNewFileInZip3 OF((zipFile file,
     crcForCtypting : crc of file to compress (needed for crypting)
  */
 
+extern int ZEXPORT zipOpenNewFileInZip4 OF((zipFile file,
+                                            const char* filename,
+                                            const zip_fileinfo* zipfi,
+                                            const void* extrafield_local,
+                                            uInt size_extrafield_local,
+                                            const void* extrafield_global,
+                                            uInt size_extrafield_global,
+                                            const char* comment,
+                                            int method,
+                                            int level,
+                                            int raw,
+                                            int windowBits,
+                                            int memLevel,
+                                            int strategy,
+                                            const char* password,
+                                            uLong crcForCtypting,
+                                            int zip64));
+
+/*
+  Same than zipOpenNewFileInZip3, except
+    zip64 : 1 to write a zip64 extra field in the local header, needed when
+            the file or its compressed data may reach 4 GB. Closing a file
+            that big which was opened without it returns ZIP_PARAMERROR.
+  Offsets past 4 GB and more than 65535 files need no flag, zip64 records
+  are added to the central directory when (and only when) they are needed.
+  Sizes and offsets are held in uLong, so this needs a 64 bit long.
+ */
+
 
 extern int ZEXPORT zipWriteInFileInZip OF((zipFile file,
                        const void* buf,
@@ -27,186 +27,1308 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "../minizip/zip.h"
+#include "../minizip/iomem.h"
+#include "../minizip/iofd.h"
+#include "../minizip/unzip.h"
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "arena.h"
 #include "buffer.h"
+#include "dtoa.h"
 #include "zipbuffer.h"
 #include "error.h"
 #include "libDataStruct/DLList.h"
 
+/***** kmls this big are split across threads rather than given one each *****/
+
+#define KMZ_SPLIT_SIZE (4 * 1024 * 1024)
+
+/***** bytes of a kml header and footer, and of the tags around a placemark *****/
+
+#define KML_ESTIMATE_DOCUMENT 128
+#define KML_ESTIMATE_PLACEMARK 256
+
+/***** significant digits KML_PREC_SHORTEST can take *****/
+
+#define KML_ESTIMATE_SHORTEST 17
+
+/***** size of the first block of a kml carved from an arena *****/
+
+#define KML_ARENA_BLOCK 4096
+
+/***** most kmls KML_free keeps for reuse, and the most content memory each keeps *****/
+
+#define KML_POOL_MAX 256
+#define KML_POOL_BLOCK (16 * 1024)
 
 /*******************************************************************************
  kml info storage struct
  
  members:
 										kmlfile			the full path of the kml file
-										kmzfile			the full path of the kmz file
+										namesize		size of the memory kmlfile is in
 										buf					the buffer struct
+										printprec		the precision to print coordantes at
+										fd					the open kml file of a streaming kml, or -1
+										zd					the compressed kml if it is compressed as it is
+																made, or NULL
+										zparams			the compression settings of the kml
+										zstats			the compression statistics, set by KMZ_write
+										arena				the arena of its kmz the kml is carved from, or
+																NULL
+										next				the next kml in the pool while it is unused
 *******************************************************************************/
 
 typedef struct {
-	char kmlfile[800];
+	char *kmlfile;
+	size_t namesize;
 	buffer buf;
-	char fmt2d[100];
-	char fmt3d[100];
+	int printprec;
+	int fd;
+	zipdeflate *zd;
+	zipparams zparams;
+	zipstats zstats;
+	arena *arena;
+	void *next;
 } KML;
 
+/*******************************************************************************
+ kmz info storage struct
+ 
+ members:
+										kmzfile			the full path of the kmz file
+										kmls				list of the kmls in the kmz
+										highwater		kmls are compressed whenever this many bytes are
+																waiting, or 0 to compress them in KMZ_write
+										threads			number of threads KMZ_write compresses with
+										zparams			the default compression settings of the kmls
+										append			flag for KMZ_write to add the kmls after the
+																entries already in the kmz file
+										bufsize			size of the buffer the kmz file is written
+																through, 0 for the default
+										arena				the arena new kmls are carved from, or NULL
+*******************************************************************************/
+
 typedef struct {
 	char *kmzfile;
 	DLList kmls;
+	size_t highwater;
+	int threads;
+	zipparams zparams;
+	int append;
+	size_t bufsize;
+	arena *arena;
 } KMZ;
 
-#include "libKML.h"
+/*******************************************************************************
+ parallel kmz write job struct
+ 
+ members:
+										kmls				the kmls in the kmz in order
+										zds					the compressed kmls
+										done				flag for each kml, set when it is compressed
+										count				the number of kmls
+										next				the next kml to compress
+										lock				lock for next and done
+										cond				signaled when a kml is done
+*******************************************************************************/
+
+typedef struct {
+	void **kmls;
+	zipdeflate **zds;
+	int *done;
+	int count;
+	int next;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} kmz_job;
+
+#include "libKML.h"
+
+/*******************************************************************************
+ function to create a new kmz
+ 
+ args:
+								kmzfile			the full path of the kmz file
+ 
+ returns:				pointer to the KMZ struct
+*******************************************************************************/
+
+KMZ *KMZ_new(
+	char *kmzfile)
+{
+	KMZ *result = NULL;
+	
+	if (!(result = calloc(sizeof(KMZ), 1)))
+		ERROR("KMZ_new");
+	
+	result->kmzfile = kmzfile;
+	zipparams_init(&result->zparams, Z_DEFLATED, Z_DEFAULT_COMPRESSION,
+								 Z_DEFAULT_STRATEGY, 0);
+	
+	return result;
+}
+
+/*******************************************************************************
+ function to create a new kmz that KMZ_write adds to the end of an existing
+ kmz file, rewriting only its central directory
+ 
+ args:
+								kmzfile			the full path of the kmz file, it is created if
+														it does not exist
+ 
+ returns:				pointer to the KMZ struct
+*******************************************************************************/
+
+KMZ *KMZ_open_append(
+	char *kmzfile)
+{
+	KMZ *result = KMZ_new(kmzfile);
+	
+	result->append = 1;
+	
+	return result;
+}
+
+
+/*******************************************************************************
+ function to have the kmls of a kmz compressed as they are made
+ 
+ args:
+								kmz					pointer to the kmz struct
+								highwater		kmls are compressed whenever this many bytes are
+														waiting, or 0 to compress them in KMZ_write
+ 
+ returns:				nothing
+*******************************************************************************/
+
+void KMZ_set_incremental(
+	KMZ *kmz,
+	size_t highwater)
+{
+	
+	kmz->highwater = highwater;
+	
+	return;
+}
+
+/*******************************************************************************
+ function to have the kmls of a kmz carved from one arena
+ 
+ args:
+								kmz					pointer to the kmz struct
+								chunksize		size of the first chunk of the arena, or 0 for
+														the default
+ 
+ returns:				nothing
+*******************************************************************************/
+
+void KMZ_set_arena(
+	KMZ *kmz,
+	size_t chunksize)
+{
+	
+	if (kmz->arena)
+		return;
+	
+	if (!(kmz->arena = malloc(sizeof(arena))))
+		ERROR("KMZ_set_arena");
+	
+	arena_init(kmz->arena, chunksize);
+	
+	return;
+}
+
+/***** kmls freed outside an arena, kept for KML_new to reuse *****/
+
+static KML *kml_pool = NULL;
+static int kml_pool_count = 0;
+static pthread_mutex_t kml_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*******************************************************************************
+	function to take a kml from the pool, it is cleared except for its name
+	and content memory
+
+	returns:
+						pointer to the kml or NULL if the pool is empty
+*******************************************************************************/
+
+static KML *kml_pool_get(void)
+{
+	KML *result;
+	char *block;
+	size_t alloced;
+	char *name;
+	size_t namesize;
+	
+	pthread_mutex_lock(&kml_pool_lock);
+	if ((result = kml_pool)) {
+		kml_pool = result->next;
+		kml_pool_count--;
+	}
+	pthread_mutex_unlock(&kml_pool_lock);
+	
+	if (!result)
+		return NULL;
+	
+	block = result->buf.buf;
+	alloced = result->buf.alloced;
+	name = result->kmlfile;
+	namesize = result->namesize;
+	
+	memset(result, 0, sizeof(KML));
+	
+	result->buf.buf = block;
+	result->buf.alloced = alloced;
+	result->kmlfile = name;
+	result->namesize = namesize;
+	
+	return result;
+}
+
+/*******************************************************************************
+	function to give a freed kml to the pool, or free it if the pool is full
+*******************************************************************************/
+
+static void kml_pool_put(
+	KML *kml)
+{
+	
+	/***** only a small block of content memory is worth keeping *****/
+	
+	buffer_reset(&(kml->buf));
+	if (kml->buf.alloced > KML_POOL_BLOCK) {
+		buffer_free(&(kml->buf));
+		kml->buf.buf = NULL;
+		kml->buf.alloced = 0;
+	}
+	
+	pthread_mutex_lock(&kml_pool_lock);
+	if (kml_pool_count < KML_POOL_MAX) {
+		kml->next = kml_pool;
+		kml_pool = kml;
+		kml_pool_count++;
+		kml = NULL;
+	}
+	pthread_mutex_unlock(&kml_pool_lock);
+	
+	if (kml) {
+		buffer_free(&(kml->buf));
+		free(kml->kmlfile);
+		free(kml);
+	}
+	
+	return;
+}
+
+/*******************************************************************************
+ function to free the kmls kept for reuse
+ 
+ args:
+								none
+ 
+ returns:
+								nothing
+*******************************************************************************/
+
+void KML_pool_free(void)
+{
+	KML *kml;
+	
+	pthread_mutex_lock(&kml_pool_lock);
+	
+	while ((kml = kml_pool)) {
+		kml_pool = kml->next;
+		buffer_free(&(kml->buf));
+		free(kml->kmlfile);
+		free(kml);
+	}
+	kml_pool_count = 0;
+	
+	pthread_mutex_unlock(&kml_pool_lock);
+	
+	return;
+}
+
+/*******************************************************************************
+	function to set the name of a kml, the memory of the old name is reused
+	when the new one fits
+*******************************************************************************/
+
+static void kml_set_name(
+	KML *kml,
+	char *kmlfile)
+{
+	size_t size = strlen(kmlfile) + 1;
+	
+	if (size > kml->namesize) {
+		if (kml->arena)
+			kml->kmlfile = arena_alloc(kml->arena, size);
+		else {
+			free(kml->kmlfile);
+			if (!(kml->kmlfile = malloc(size)))
+				ERROR("kml_set_name");
+		}
+		kml->namesize = size;
+	}
+	
+	memcpy(kml->kmlfile, kmlfile, size);
+	
+	return;
+}
+
+/*******************************************************************************
+ function to create a new kml
+ 
+ args:
+								kmz					pointer to the kmz to add it to
+								kmlfile			the full path of the kml file
+								printprec		the precision to print coordantes at or
+														KML_PREC_SHORTEST
+ 
+ returns:				pointer to the KML struct
+*******************************************************************************/
+
+KML *KML_new(
+	KMZ *kmz,
+	char *kmlfile,
+	int printprec)
+{
+	KML *result = NULL;
+	
+	/***** kmls of a kmz with an arena start out in it *****/
+	
+	if (kmz && kmz->arena) {
+		result = arena_alloc(kmz->arena, sizeof(KML));
+		result->arena = kmz->arena;
+		buffer_set_block(&(result->buf), arena_alloc(kmz->arena, KML_ARENA_BLOCK),
+										 KML_ARENA_BLOCK);
+	}
+	
+	else if (!(result = kml_pool_get()) &&
+					 !(result = calloc(sizeof(KML), 1)))
+		ERROR("KML_new");
+	
+	kml_set_name(result, kmlfile);
+	
+	result->printprec = printprec;
+	result->fd = -1;
+	
+	if (kmz)
+		result->zparams = kmz->zparams;
+	else
+		zipparams_init(&result->zparams, Z_DEFLATED, Z_DEFAULT_COMPRESSION,
+									 Z_DEFAULT_STRATEGY, 0);
+	
+	/***** kmls for a kmz sum their crc as they are made *****/
+	
+	if (kmz)
+		buffer_set_crc(&(result->buf));
+	
+	if (kmz && kmz->highwater) {
+		if (result->arena)
+			result->zd = arena_alloc(kmz->arena, sizeof(zipdeflate));
+		else if (!(result->zd = malloc(sizeof(zipdeflate))))
+			ERROR("KML_new");
+		
+		zipdeflate_init(result->zd, &result->zparams);
+		result->zd->nocrc = 1;
+		buffer_set_flush(&(result->buf), zipdeflate_write, result->zd,
+										 kmz->highwater);
+	}
+	
+	if (kmz)
+		DLList_append(&kmz->kmls, result);
+	
+	return result;	
+}
+
+/*******************************************************************************
+	buffer flush function to write a streaming kml to its file
+*******************************************************************************/
+
+static int kml_stream_flush(
+	const char *data,
+	size_t len,
+	void *extra)
+{
+	KML *kml = extra;
+	
+	while (len > 0) {
+		ssize_t written = write(kml->fd, data, len);
+		
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		
+		data += written;
+		len -= written;
+	}
+	
+	return 0;
+}
+
+/*******************************************************************************
+ function to create a new kml that is written to disk as it is made
+ 
+ args:
+								kmlfile			the full path of the kml file
+								printprec		the precision to print coordantes at or
+														KML_PREC_SHORTEST
+								highwater		the kml is written out whenever this many bytes
+														are waiting, or 0 for KML_STREAM_HIGHWATER
+ 
+ returns:				pointer to the KML struct
+								exit()s if the file cannot be opened
+*******************************************************************************/
+
+KML *KML_new_stream(
+	char *kmlfile,
+	int printprec,
+	size_t highwater)
+{
+	KML *result = KML_new(NULL, kmlfile, printprec);
+	
+	if (0 > (result->fd = open(result->kmlfile, O_WRONLY | O_CREAT | O_TRUNC,
+														 0666)))
+		ERROR("KML_new_stream");
+	
+	if (!highwater)
+		highwater = KML_STREAM_HIGHWATER;
+	
+	buffer_set_flush(&(result->buf), kml_stream_flush, result, highwater);
+	
+	return result;
+}
+
+/*******************************************************************************
+ function to free a kml struct
+ 
+ args:
+								kml				pointer to the kml struct
+ 
+ returns:
+								nothing
+*******************************************************************************/
+
+void KML_free(
+	KML *kml)
+{
+	
+	if (kml->fd >= 0)
+		close(kml->fd);
+	
+	if (kml->zd) {
+		zipdeflate_free(kml->zd);
+		if (!kml->arena)
+			free(kml->zd);
+	}
+	
+	/***** a kml in an arena goes with it, others are kept for reuse *****/
+	
+	if (kml->arena)
+		buffer_free (&(kml->buf));
+	else
+		kml_pool_put(kml);
+	
+	return;
+}
+
+/*******************************************************************************
+ function to empty a kml so it can be made again, the memory its buffer has
+ grown to is kept
+ 
+ args:
+								kml				pointer to the kml struct
+								kmlfile		the full path of the kml file, or NULL to keep
+													the one it has
+ 
+ returns:
+								nothing
+								exit()s if the file of a streaming kml cannot be opened
+*******************************************************************************/
+
+void KML_reset(
+	KML *kml,
+	char *kmlfile)
+{
+	
+	if (kmlfile)
+		kml_set_name(kml, kmlfile);
+	
+	buffer_reset(&(kml->buf));
+	
+	if (kml->zd)
+		zipdeflate_reset(kml->zd);
+	
+	memset(&(kml->zstats), 0, sizeof(zipstats));
+	
+	/***** a streaming kml starts its file over, KML_write may have closed it *****/
+	
+	if (kml->buf.flush == kml_stream_flush) {
+		if (kml->fd >= 0)
+			close(kml->fd);
+		
+		if (0 > (kml->fd = open(kml->kmlfile, O_WRONLY | O_CREAT | O_TRUNC,
+														0666)))
+			ERROR("KML_reset");
+	}
+	
+	return;
+}
+
+/*******************************************************************************
+	dllist iterate function to empty the kmls of a kmz
+*******************************************************************************/
+
+void *kmz_reset_iterate(
+	DLList *list,
+	DLList_node *node,
+	void *data,
+	void *extra)
+{
+	KML *kml = data;
+	
+	KML_reset(kml, NULL);
+	
+	return NULL;
+}
+
+/*******************************************************************************
+ function to empty all the kmls of a kmz so they can be made again, the
+ kmls and the memory their buffers have grown to are kept
+ 
+ args:
+								kmz				pointer to the kmz struct
+ 
+ returns:
+								nothing
+*******************************************************************************/
+
+void KMZ_reset(
+	KMZ *kmz)
+{
+	
+	DLList_iterate(&kmz->kmls, kmz_reset_iterate, NULL);
+	
+	return;
+}
+
+/*******************************************************************************
+	dllist iterate function to free a kmz
+*******************************************************************************/
+
+void *kmz_free_iterate(
+	DLList *list,
+	DLList_node *node,
+	void *data,
+	void *extra)
+{
+	KML *kml = data;
+	
+	KML_free (kml);
+	
+	return NULL;
+}
+
+/*******************************************************************************
+ function to free a kmz struct
+ 
+ args:
+								kmz				pointer to the kmz struct
+ 
+ returns:
+								nothing
+*******************************************************************************/
+
+void KMZ_free(
+	KMZ *kmz)
+{
+	
+	DLList_delete_all(&kmz->kmls, (DLList_data_free_func) KML_free);
+	
+	if (kmz->arena) {
+		arena_free(kmz->arena);
+		free(kmz->arena);
+	}
+	
+	free(kmz);
+	
+	return;
+}
+/*******************************************************************************
+	dllist iterate function to write a kmz
+*******************************************************************************/
+
+void *kmz_write_iterate(
+	DLList *list,
+	DLList_node *node,
+	void *data,
+	void *extra)
+{
+	KML *kml = data;
+	zipFile zf = extra;
+	
+	if (kml->zd) {
+		buffer_flush(&(kml->buf));
+		zipdeflate_finish(kml->zd);
+		kml->zd->crc = buffer_crc(&(kml->buf));
+		zipbuffer_add_deflated(kml->kmlfile, zf, kml->zd, &kml->zstats);
+	}
+	else
+		zipbuffer_add(kml->kmlfile, zf, &(kml->buf), &kml->zparams,
+									&kml->zstats);
+	
+	return NULL;
+}
+
+/*******************************************************************************
+	dllist iterate function to gather the kmls of a kmz into a job
+*******************************************************************************/
+
+void *kmz_job_iterate(
+	DLList *list,
+	DLList_node *node,
+	void *data,
+	void *extra)
+{
+	kmz_job *job = extra;
+	
+	if (job->kmls)
+		job->kmls[job->count] = data;
+	job->count++;
+	
+	return NULL;
+}
+
+/*******************************************************************************
+	function to gather the kmls of a kmz into a job, none of them done
+*******************************************************************************/
+
+static void kmz_job_init(
+	KMZ *kmz,
+	kmz_job *job)
+{
+	
+	memset(job, 0, sizeof(kmz_job));
+	
+	DLList_iterate(&kmz->kmls, kmz_job_iterate, job);
+	
+	/***** calloc(0) may return NULL, an empty job needs no arrays *****/
+	
+	if (!job->count)
+		return;
+	
+	if (!(job->kmls = calloc(job->count, sizeof(void *))) ||
+			!(job->zds = calloc(job->count, sizeof(zipdeflate *))) ||
+			!(job->done = calloc(job->count, sizeof(int))))
+		ERROR("kmz_job_init");
+	
+	job->count = 0;
+	DLList_iterate(&kmz->kmls, kmz_job_iterate, job);
+	
+	return;
+}
+
+/*******************************************************************************
+	function to free the arrays of a job
+*******************************************************************************/
+
+static void kmz_job_free(
+	kmz_job *job)
+{
+	
+	free(job->done);
+	free(job->zds);
+	free(job->kmls);
+	
+	return;
+}
+
+/*******************************************************************************
+	function to compress one kml of a job, the result is owned by the job
+	unless it is the stream of a kml compressed as it is made
+*******************************************************************************/
+
+static zipdeflate *kmz_job_deflate(
+	KML *kml)
+{
+	zipdeflate *zd;
+	
+	if (kml->zd) {
+		buffer_flush(&(kml->buf));
+		zd = kml->zd;
+	}
+	
+	else {
+		if (!(zd = malloc(sizeof(zipdeflate))))
+			ERROR("kmz_job_deflate");
+		
+		zipdeflate_init(zd, &kml->zparams);
+		zd->nocrc = kml->buf.crcon;
+		
+		if (buffer_iterate(&(kml->buf), zipdeflate_write, zd))
+			ERROR("kmz_job_deflate");
+	}
+	
+	zipdeflate_finish(zd);
+	
+	if (zd->nocrc)
+		zd->crc = buffer_crc(&(kml->buf));
+	
+	return zd;
+}
+
+/*******************************************************************************
+	worker thread function to compress the kmls of a job
+*******************************************************************************/
+
+static void *kmz_job_worker(
+	void *arg)
+{
+	kmz_job *job = arg;
+	
+	while (1) {
+		zipdeflate *zd = NULL;
+		KML *kml;
+		int i;
+		
+		pthread_mutex_lock(&job->lock);
+		i = job->next++;
+		pthread_mutex_unlock(&job->lock);
+		
+		if (i >= job->count)
+			break;
+		
+		/***** big kmls are left for the writer to split across threads *****/
+		
+		kml = job->kmls[i];
+		if (kml->zd || buffer_length(&(kml->buf)) < KMZ_SPLIT_SIZE)
+			zd = kmz_job_deflate(kml);
+		
+		pthread_mutex_lock(&job->lock);
+		job->zds[i] = zd;
+		job->done[i] = 1;
+		pthread_cond_broadcast(&job->cond);
+		pthread_mutex_unlock(&job->lock);
+	}
+	
+	return NULL;
+}
+
+/*******************************************************************************
+	function to write a kmz compressing its kmls on several threads, each
+	kml is written as soon as it and all the kmls before it are done
+*******************************************************************************/
+
+static void kmz_write_parallel(
+	KMZ *kmz,
+	zipFile zf)
+{
+	kmz_job job;
+	pthread_t *threads;
+	int nthreads = kmz->threads;
+	int i;
+	
+	kmz_job_init(kmz, &job);
+	
+	if (!job.count)
+		return;
+	
+	pthread_mutex_init(&job.lock, NULL);
+	pthread_cond_init(&job.cond, NULL);
+	
+	if (nthreads > job.count)
+		nthreads = job.count;
+	
+	if (!(threads = calloc(nthreads, sizeof(pthread_t))))
+		ERROR("kmz_write_parallel");
+	
+	for (i = 0 ; i < nthreads ; i++) {
+		if (pthread_create(threads + i, NULL, kmz_job_worker, &job))
+			ERROR("kmz_write_parallel");
+	}
+	
+	/***** write in the original order while later kmls compress *****/
+	
+	for (i = 0 ; i < job.count ; i++) {
+		KML *kml = job.kmls[i];
+		
+		pthread_mutex_lock(&job.lock);
+		while (!job.done[i])
+			pthread_cond_wait(&job.cond, &job.lock);
+		pthread_mutex_unlock(&job.lock);
+		
+		if (!job.zds[i]) {
+			zipbuffer_add_parallel(kml->kmlfile, zf, &(kml->buf), &kml->zparams,
+														 kmz->threads, &kml->zstats);
+			continue;
+		}
+		
+		zipbuffer_add_deflated(kml->kmlfile, zf, job.zds[i], &kml->zstats);
+		
+		/***** a kml compressed as it is made keeps its stream for KML_reset *****/
+		
+		if (job.zds[i] != kml->zd) {
+			zipdeflate_free(job.zds[i]);
+			free(job.zds[i]);
+		}
+	}
+	
+	for (i = 0 ; i < nthreads ; i++)
+		pthread_join(threads[i], NULL);
+	
+	pthread_cond_destroy(&job.cond);
+	pthread_mutex_destroy(&job.lock);
+	
+	free(threads);
+	kmz_job_free(&job);
+	
+	return;
+}
+
+/*******************************************************************************
+	function to write the kmls of a kmz into an open zip
+*******************************************************************************/
+
+static void kmz_write_zip(
+	KMZ *kmz,
+	zipFile zf)
+{
+	kmz_job count = {0};
+	
+	/***** with no kmls array the job only counts them *****/
+	
+	DLList_iterate(&kmz->kmls, kmz_job_iterate, &count);
+	zipbuffer_reserve(zf, count.count);
+	
+	if (kmz->threads > 1)
+		kmz_write_parallel(kmz, zf);
+	else
+		DLList_iterate(&kmz->kmls, kmz_write_iterate, zf);
+	
+	zipbuffer_close(zf);
+	
+	return;
+}
+
+/*******************************************************************************
+ function to write a kmz to disk
+ 
+ args:
+								kmz				pointer to the kmz struct
+ 
+ returns:
+								nothing
+*******************************************************************************/
+
+void KMZ_write(
+	KMZ *kmz)
+{
+	
+	if (kmz->append)
+		kmz_write_zip(kmz, zipbuffer_open_append(kmz->kmzfile, kmz->bufsize));
+	else
+		kmz_write_zip(kmz, zipbuffer_open(kmz->kmzfile, kmz->bufsize));
+	
+	return;
+}
+
+/*******************************************************************************
+ function to write a kmz to memory
+ 
+ args:
+								kmz				pointer to the kmz struct
+								size			set to the size of the kmz
+ 
+ returns:
+								pointer to the kmz data, the caller must free() it
+*******************************************************************************/
+
+char *KMZ_write_to_memory(
+	KMZ *kmz,
+	size_t *size)
+{
+	ourmemory_t mem = {0};
+	
+	kmz_write_zip(kmz, zipbuffer_open_memory(&mem));
+	
+	*size = mem.size;
+	
+	return mem.base;
+}
+
+/*******************************************************************************
+ function to write a kmz to an open file descriptor, which need not be
+ seekable
+ 
+ args:
+								kmz				pointer to the kmz struct
+								fd				the file descriptor, it is left open
+ 
+ returns:
+								nothing
+*******************************************************************************/
+
+void KMZ_write_fd(
+	KMZ *kmz,
+	int fd)
+{
+	ourfd_t ourfd = {fd, 0};
+	
+	kmz_write_zip(kmz, zipbuffer_open_fd(&ourfd));
+	
+	return;
+}
+
+/*******************************************************************************
+ function to update a kmz on disk. each kml in the kmz replaces the entry of
+ the same name, or is added after the other entries if there is none. all
+ the other entries are copied over still compressed
+ 
+ args:
+								kmz				pointer to the kmz struct
+ 
+ returns:
+								nothing
+								exit()s on error
+*******************************************************************************/
+
+void KMZ_update(
+	KMZ *kmz)
+{
+	kmz_job job;
+	unz_global_info info;
+	unzFile uF;
+	zipFile zf;
+	char *tmpfile;
+	unz_file_info finfo;
+	char *name = NULL;
+	size_t namesize = 0;
+	int err;
+	int i;
+	
+	/***** nothing to update, write it all *****/
+	
+	if (!(uF = unzOpen(kmz->kmzfile))) {
+		KMZ_write(kmz);
+		return;
+	}
+	
+	if (!(tmpfile = malloc(strlen(kmz->kmzfile) + 5)))
+		ERROR("KMZ_update");
+	
+	sprintf(tmpfile, "%s.tmp", kmz->kmzfile);
+	zf = zipbuffer_open(tmpfile, kmz->bufsize);
+	
+	/***** done marks the kmls that have been written *****/
+	
+	kmz_job_init(kmz, &job);
+	
+	if (UNZ_OK != unzGetGlobalInfo(uF, &info))
+		ERROR("KMZ_update");
+	
+	zipbuffer_reserve(zf, info.number_entry + job.count);
+	
+	for (err = unzGoToFirstFile(uF) ; err == UNZ_OK ; err = unzGoToNextFile(uF)) {
+		/***** the name is read whole, however long it is *****/
+		
+		if (UNZ_OK != unzGetCurrentFileInfo(uF, &finfo, NULL, 0, NULL, 0, NULL, 0))
+			ERROR("KMZ_update");
+		
+		if (finfo.size_filename + 1 > namesize) {
+			free(name);
+			namesize = finfo.size_filename + 1;
+			if (!(name = malloc(namesize)))
+				ERROR("KMZ_update");
+		}
+		
+		if (UNZ_OK != unzGetCurrentFileInfo(uF, NULL, name, namesize,
+																				NULL, 0, NULL, 0))
+			ERROR("KMZ_update");
+		
+		for (i = 0 ; i < job.count ; i++) {
+			KML *kml = job.kmls[i];
+			
+			if (!job.done[i] && !strcmp(kml->kmlfile, name))
+				break;
+		}
+		
+		if (i < job.count) {
+			kmz_write_iterate(NULL, NULL, job.kmls[i], zf);
+			job.done[i] = 1;
+		}
+		
+		else
+			zipbuffer_copy_raw(uF, zf);
+	}
+	
+	if (err != UNZ_END_OF_LIST_OF_FILE)
+		ERROR("KMZ_update");
+	
+	/***** new kmls go at the end *****/
+	
+	for (i = 0 ; i < job.count ; i++) {
+		if (!job.done[i])
+			kmz_write_iterate(NULL, NULL, job.kmls[i], zf);
+	}
+	
+	zipbuffer_close(zf);
+	unzClose(uF);
+	
+	if (rename(tmpfile, kmz->kmzfile))
+		ERROR("KMZ_update");
+	
+	kmz_job_free(&job);
+	free(tmpfile);
+	free(name);
+	
+	return;
+}
+
+/*******************************************************************************
+ function to set the number of threads a kmz is compressed with
+ 
+ args:
+								kmz				pointer to the kmz struct
+								threads		the number of threads, 1 or less for none
+ 
+ returns:
+								nothing
+*******************************************************************************/
+
+void KMZ_set_threads(
+	KMZ *kmz,
+	int threads)
+{
+	
+	kmz->threads = threads;
+	
+	return;
+}
+
+/*******************************************************************************
+ function to set the size of the buffer a kmz file is written through
+ 
+ args:
+								kmz				pointer to the kmz struct
+								bufsize		the size in bytes, 0 for the default
+ 
+ returns:
+								nothing
+*******************************************************************************/
+
+void KMZ_set_write_buffer(
+	KMZ *kmz,
+	size_t bufsize)
+{
+	
+	kmz->bufsize = bufsize;
+	
+	return;
+}
 
 /*******************************************************************************
- function to create a new kmz
+ function to set the default compression settings of the kmls in a kmz,
+ kmls made before this keep the settings they have
  
  args:
-								kmzfile			the full path of the kmz file
+								kmz				pointer to the kmz struct
+								method		KML_DEFLATED, or KML_STORED
+								level			the zlib compression level
+								strategy	the zlib deflate strategy
+								memlevel	the zlib memory level, or 0 for the default
  
- returns:				pointer to the KMZ struct
+ returns:
+								nothing
 *******************************************************************************/
 
-KMZ *KMZ_new(
-	char *kmzfile)
+void KMZ_set_compression(
+	KMZ *kmz,
+	int method,
+	int level,
+	int strategy,
+	int memlevel)
 {
-	KMZ *result = NULL;
-	
-	if (!(result = calloc(sizeof(KMZ), 1)))
-		ERROR("KMZ_new");
 	
-	result->kmzfile = kmzfile;
+	zipparams_init(&kmz->zparams, method, level, strategy, memlevel);
 	
-	return result;
+	return;
 }
 
-
 /*******************************************************************************
- function to create a new kml
+ function to have the kmls of a kmz compressed so that rsync can find the
+ unchanged parts, kmls made before this keep the settings they have
  
  args:
-								kmz					pointer to the kmz to add it to
-								kmlfile			the full path of the kml file
-								printprec		the precision to print coordantes at
+								kmz					pointer to the kmz struct
+								rsyncable		1 to turn it on, 0 to turn it off
  
- returns:				pointer to the KML struct
+ returns:
+								nothing
 *******************************************************************************/
 
-KML *KML_new(
+void KMZ_set_rsyncable(
 	KMZ *kmz,
-	char *kmlfile,
-	int printprec)
+	int rsyncable)
 {
-	KML *result = NULL;
 	
-	if (!(result = calloc(sizeof(KML), 1)))
-		ERROR("KML_new");
+	kmz->zparams.rsyncable = rsyncable;
 	
-	strncpy(result->kmlfile, kmlfile, sizeof(result->kmlfile));
+	return;
+}
+
+/*******************************************************************************
+	function to restart the stream of a kml compressed as it is made, once
+	its settings have changed
+*******************************************************************************/
+
+static void kml_restart_deflate(
+	KML *kml)
+{
 	
-	snprintf(result->fmt2d, sizeof(result->fmt2d), "%%.%ilg,%%.%ilg ",
-					 printprec, printprec);
-	snprintf(result->fmt3d, sizeof(result->fmt3d), "%%.%ilg,%%.%ilg,%%.%ilg ",
-					 printprec, printprec, printprec);
+	if (!kml->zd)
+		return;
 	
-	if (kmz)
-		DLList_append(&kmz->kmls, result);
+	if (kml->zd->size)
+		ERROR("kml_restart_deflate");
 	
-	return result;	
+	zipdeflate_free(kml->zd);
+	zipdeflate_init(kml->zd, &kml->zparams);
+	kml->zd->nocrc = 1;
+	
+	return;
 }
 
 /*******************************************************************************
- function to free a kml struct
+ function to set the compression settings of a kml
  
  args:
 								kml				pointer to the kml struct
+								method		KML_DEFLATED, or KML_STORED
+								level			the zlib compression level
+								strategy	the zlib deflate strategy
+								memlevel	the zlib memory level, or 0 for the default
  
  returns:
 								nothing
+								exit()s if the kml has already been partly compressed
 *******************************************************************************/
 
-void KML_free(
-	KML *kml)
+void KML_set_compression(
+	KML *kml,
+	int method,
+	int level,
+	int strategy,
+	int memlevel)
 {
 	
-	buffer_free (&(kml->buf));
-	free(kml);
+	zipparams_init(&kml->zparams, method, level, strategy, memlevel);
+	kml_restart_deflate(kml);
 	
 	return;
 }
 
 /*******************************************************************************
-	dllist iterate function to free a kmz
+ function to have a kml compressed so that rsync can find the unchanged parts
+ 
+ args:
+								kml					pointer to the kml struct
+								rsyncable		1 to turn it on, 0 to turn it off
+ 
+ returns:
+								nothing
+								exit()s if the kml has already been partly compressed
 *******************************************************************************/
 
-void *kmz_free_iterate(
-	DLList *list,
-	DLList_node *node,
-	void *data,
-	void *extra)
+void KML_set_rsyncable(
+	KML *kml,
+	int rsyncable)
 {
-	KML *kml = data;
 	
-	KML_free (kml);
+	kml->zparams.rsyncable = rsyncable;
+	kml_restart_deflate(kml);
 	
-	return NULL;
+	return;
 }
 
 /*******************************************************************************
- function to free a kmz struct
+ function to get the compression statistics of a kml after KMZ_write
  
  args:
-								kmz				pointer to the kmz struct
+								kml					pointer to the kml struct
+								size				set to the uncompressed size
+								compressed	set to the compressed size
+								seconds			set to the time spent compressing
  
  returns:
 								nothing
 *******************************************************************************/
 
-void KMZ_free(
-	KMZ *kmz)
+void KML_get_compression_stats(
+	KML *kml,
+	size_t *size,
+	size_t *compressed,
+	double *seconds)
 {
 	
-	DLList_delete_all(&kmz->kmls, (DLList_data_free_func) KML_free);
-	
-	free(kmz);
+	*size = kml->zstats.size;
+	*compressed = kml->zstats.compressed;
+	*seconds = kml->zstats.seconds;
 	
 	return;
 }
+
 /*******************************************************************************
-	dllist iterate function to write a kmz
+	dllist iterate function to total the compression statistics of a kmz
 *******************************************************************************/
 
-void *kmz_write_iterate(
+void *kmz_stats_iterate(
 	DLList *list,
 	DLList_node *node,
 	void *data,
 	void *extra)
 {
 	KML *kml = data;
-	zipFile zf = extra;
-	zipbuffer_add(kml->kmlfile, zf, &(kml->buf));
+	zipstats *total = extra;
+	
+	total->size += kml->zstats.size;
+	total->compressed += kml->zstats.compressed;
+	total->seconds += kml->zstats.seconds;
 	
 	return NULL;
 }
 
 /*******************************************************************************
- function to write a kmz to disk
+ function to get the compression statistics of a whole kmz after KMZ_write
  
  args:
-								kmz				pointer to the kmz struct
+								kmz					pointer to the kmz struct
+								size				set to the total uncompressed size
+								compressed	set to the total compressed size
+								seconds			set to the total time spent compressing
  
  returns:
 								nothing
 *******************************************************************************/
 
-void KMZ_write(
-	KMZ *kmz)
+void KMZ_get_compression_stats(
+	KMZ *kmz,
+	size_t *size,
+	size_t *compressed,
+	double *seconds)
 {
+	zipstats total = {0};
 	
-	zipFile zf = zipbuffer_open(kmz->kmzfile);
+	DLList_iterate(&kmz->kmls, kmz_stats_iterate, &total);
 	
-	DLList_iterate(&kmz->kmls, kmz_write_iterate, zf);
-	
-	zipbuffer_close(zf);
+	*size = total.size;
+	*compressed = total.compressed;
+	*seconds = total.seconds;
 	
 	return;
 }
@@ -225,17 +1347,110 @@ void KML_write(
 	KML *kml)
 {
 	
-	FILE *fp;
+	int fd;
 	
-	if (!(fp = fopen(kml->kmlfile, "w")))
-		ERROR("KML_write");
+	/***** a streaming kml only has what is left to write *****/
+	
+	if (kml->fd >= 0) {
+		buffer_flush(&(kml->buf));
+		
+		if (close(kml->fd))
+			ERROR("KML_write");
+		
+		kml->fd = -1;
 		
-	fputs(kml->buf.buf, fp);
-	fclose(fp);
+		return;
+	}
+	
+	if (0 > (fd = open(kml->kmlfile, O_WRONLY | O_CREAT | O_TRUNC, 0666)))
+		ERROR("KML_write");
+	
+	if (buffer_write_fd(&(kml->buf), fd))
+		ERROR("KML_write");
+	
+	if (close(fd))
+		ERROR("KML_write");
+	
+	return;
+}
+
+/*******************************************************************************
+ function to set the block size of a kml
+ 
+ args:
+								kml				pointer to the kml struct
+								blocksize	size of the blocks the kml is kept in, or 0
+													for one contiguous block
+ 
+ returns:
+								nothing
+*******************************************************************************/
+
+void KML_set_blocksize(
+	KML *kml,
+	size_t blocksize)
+{
+	
+	buffer_set_segsize(&(kml->buf), blocksize);
+	
+	return;
+}
+
+/*******************************************************************************
+ function to allocate room in a kml for what is going to be added to it
+ 
+ args:
+								kml				pointer to the kml struct
+								bytes			the number of bytes expected
+ 
+ returns:
+								nothing
+								exit()s on error
+*******************************************************************************/
+
+void KML_reserve(
+	KML *kml,
+	size_t bytes)
+{
+	
+	buffer_reserve(&(kml->buf), bytes);
 	
 	return;
 }
 
+/*******************************************************************************
+ function to estimate the size of a kml
+ 
+ args:
+								placemarks	the number of placemarks
+								vertices		the total number of coordinate tuples
+								printprec		the precision the coordinates are printed at
+														or KML_PREC_SHORTEST
+								dims				the number of values in each tuple
+ 
+ returns:
+								the estimated number of bytes
+*******************************************************************************/
+
+size_t KML_estimate_size(
+	size_t placemarks,
+	size_t vertices,
+	int printprec,
+	int dims)
+{
+	size_t value;
+	
+	if (printprec < 0)
+		printprec = KML_ESTIMATE_SHORTEST;
+	
+	/***** the digits, a sign, a decimal point and a separator *****/
+	
+	value = printprec + 3;
+	
+	return KML_ESTIMATE_DOCUMENT + placemarks * KML_ESTIMATE_PLACEMARK +
+				 vertices * dims * value;
+}
+
 /*******************************************************************************
  function to add a kml header to a kml
  
@@ -251,9 +1466,9 @@ void KML_header (
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf(buf, "<?xml version=\"1.0\" encoding=\"utf-8\" ?>\n");
-	buffer_printf(buf, "<kml xmlns=\"http://www.opengis.net/kml/2.2\">\n");
-	buffer_printf(buf, "<Document>\n");
+	buffer_literal(buf, "<?xml version=\"1.0\" encoding=\"utf-8\" ?>\n");
+	buffer_literal(buf, "<kml xmlns=\"http://www.opengis.net/kml/2.2\">\n");
+	buffer_literal(buf, "<Document>\n");
 	buf->indent++;
  return;
 }
@@ -273,8 +1488,13 @@ void KML_footer (
 {
 	buffer *buf = &(kml->buf);
 	buf->indent--;
-	buffer_printf(buf, "</Document>\n");
-	buffer_printf(buf, "</kml>\n");
+	buffer_literal(buf, "</Document>\n");
+	buffer_literal(buf, "</kml>\n");
+	
+	/***** nothing more is coming so compress it now *****/
+	
+	if (kml->zd)
+		buffer_flush(buf);
 	
 	return;
 }
@@ -294,7 +1514,9 @@ void KML_name(
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf(buf, "  <name>%s</name>\n", name);
+	buffer_literal(buf, "  <name>");
+	buffer_append_str(buf, name);
+	buffer_literal_noindent(buf, "</name>\n");
 	
 	return;
 }
@@ -314,9 +1536,9 @@ void KML_desc(
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf(buf, "<description>");
-		buffer_printf(buf, "%s", desc);
-	buffer_printf(buf, "</description>\n");
+	buffer_literal(buf, "<description>");
+		buffer_append(buf, desc, strlen(desc));
+	buffer_literal(buf, "</description>\n");
 	
 	return;
 }
@@ -342,16 +1564,22 @@ void KML_placemark_header (
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf(buf, "<Placemark>\n");
-	if (name)
-		buffer_printf(buf, "  <name>%s</name>\n", name);
+	buffer_literal(buf, "<Placemark>\n");
+	if (name) {
+		buffer_literal(buf, "  <name>");
+		buffer_append_str(buf, name);
+		buffer_literal_noindent(buf, "</name>\n");
+	}
 	if (desc) {
-		buffer_printf(buf, "  <description>");
-		buffer_printf(buf, "%s", desc);
-		buffer_printf(buf, "  </description>\n");
+		buffer_literal(buf, "  <description>");
+		buffer_append(buf, desc, strlen(desc));
+		buffer_literal(buf, "  </description>\n");
+	}
+	if (styleid) {
+		buffer_literal(buf, "  <styleUrl>#");
+		buffer_append_str(buf, styleid);
+		buffer_literal_noindent(buf, "</styleUrl>\n");
 	}
-	if (styleid)
-		buffer_printf(buf, "  <styleUrl>#%s</styleUrl>\n", styleid);
 	
 	buf->indent++;
 	
@@ -374,7 +1602,7 @@ void KML_placemark_footer (
 	buffer *buf = &(kml->buf);
 	
 	buf->indent--;
-  buffer_printf(buf, "</Placemark>\n");
+  buffer_literal(buf, "</Placemark>\n");
 	
 	return;
 }
@@ -394,9 +1622,9 @@ void KML_icon_header (
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf(buf, "<Point>\n");
+	buffer_literal(buf, "<Point>\n");
 
-	buffer_printf(buf, "  <coordinates>");
+	buffer_literal(buf, "  <coordinates>");
 	buf->indent++;
 	
 	return;
@@ -418,8 +1646,8 @@ void KML_icon_footer (
 	buffer *buf = &(kml->buf);
 	
 	buf->indent--;
-	buffer_printf_noindent(buf, "</coordinates>\n");
-	buffer_printf(buf, "</Point>\n");
+	buffer_literal_noindent(buf, "</coordinates>\n");
+	buffer_literal(buf, "</Point>\n");
 
 	return;
 }
@@ -444,20 +1672,20 @@ void KML_linestring_header (
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf(buf, "<LineString>\n");
+	buffer_literal(buf, "<LineString>\n");
 	if (extrude)
-		buffer_printf(buf, "  <extrude>1</extrude>\n");
+		buffer_literal(buf, "  <extrude>1</extrude>\n");
 	if (tessellate)		
-		buffer_printf(buf, "  <tessellate>1</tessellate>\n");
+		buffer_literal(buf, "  <tessellate>1</tessellate>\n");
 	
 	switch (altitudeMode) {
 	
 		case relativeToGround:
-			buffer_printf(buf, "  <altitudeMode>relativeToGround</altitudeMode>\n");
+			buffer_literal(buf, "  <altitudeMode>relativeToGround</altitudeMode>\n");
 			break;
 		
 		case absolute:
-			buffer_printf(buf, "  <altitudeMode>absolute</altitudeMode>\n");
+			buffer_literal(buf, "  <altitudeMode>absolute</altitudeMode>\n");
 			break;
 		
 		case clampToGround:
@@ -465,7 +1693,7 @@ void KML_linestring_header (
 			break;
 	}
 	
-	buffer_printf(buf, "  <coordinates>");
+	buffer_literal(buf, "  <coordinates>");
 	buf->indent++;
 
 	return;
@@ -487,8 +1715,8 @@ void KML_linestring_footer (
 	buffer *buf = &(kml->buf);
 	
 	buf->indent--;
-	buffer_printf_noindent(buf, "</coordinates>\n");
-	buffer_printf(buf, "</LineString>\n");
+	buffer_literal_noindent(buf, "</coordinates>\n");
+	buffer_literal(buf, "</LineString>\n");
 
 	return;
 }
@@ -513,21 +1741,21 @@ void KML_polygon_header (
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf(buf, "<Polygon>\n");
+	buffer_literal(buf, "<Polygon>\n");
 		if (extrude)
-		buffer_printf(buf, "  <extrude>1</extrude>\n");
+		buffer_literal(buf, "  <extrude>1</extrude>\n");
 	if (tessellate)		
-		buffer_printf(buf, "  <tessellate>1</tessellate>\n");
+		buffer_literal(buf, "  <tessellate>1</tessellate>\n");
 
 	
 	switch (altitudeMode) {
 	
 		case relativeToGround:
-			buffer_printf(buf, "  <altitudeMode>relativeToGround</altitudeMode>\n");
+			buffer_literal(buf, "  <altitudeMode>relativeToGround</altitudeMode>\n");
 			break;
 		
 		case absolute:
-			buffer_printf(buf, "  <altitudeMode>absolute</altitudeMode>\n");
+			buffer_literal(buf, "  <altitudeMode>absolute</altitudeMode>\n");
 			break;
 		
 		case clampToGround:
@@ -555,7 +1783,7 @@ void KML_polygon_footer (
 	buffer *buf = &(kml->buf);
 	
 	buf->indent--;
-	buffer_printf(buf, "</Polygon>\n");
+	buffer_literal(buf, "</Polygon>\n");
 	
 	return;
 }
@@ -577,7 +1805,7 @@ void KML_outerboundry_header (
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf(buf, "<outerBoundaryIs>\n");
+	buffer_literal(buf, "<outerBoundaryIs>\n");
 	buf->indent++;
 	
 	return;
@@ -599,7 +1827,7 @@ void KML_outerboundry_footer (
 	buffer *buf = &(kml->buf);
 	
 	buf->indent--;
-	buffer_printf(buf, "</outerBoundaryIs>\n");
+	buffer_literal(buf, "</outerBoundaryIs>\n");
 	
 	return;
 }
@@ -619,7 +1847,7 @@ void KML_innerboundry_header (
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf(buf, "<innerBoundaryIs>\n");
+	buffer_literal(buf, "<innerBoundaryIs>\n");
 	buf->indent++;
 	
 	return;
@@ -641,7 +1869,7 @@ void KML_innerboundry_footer (
 	buffer *buf = &(kml->buf);
 	
 	buf->indent--;
-	buffer_printf(buf, "</innerBoundaryIs>\n");
+	buffer_literal(buf, "</innerBoundaryIs>\n");
 	
 	return;
 }
@@ -666,20 +1894,20 @@ void KML_linearring_header (
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf(buf, "<LinearRing>\n");;
+	buffer_literal(buf, "<LinearRing>\n");;
 	if (extrude)
-		buffer_printf(buf, "  <extrude>1</extrude>\n");
+		buffer_literal(buf, "  <extrude>1</extrude>\n");
 	if (tessellate)		
-		buffer_printf(buf, "  <tessellate>1</tessellate>\n");
+		buffer_literal(buf, "  <tessellate>1</tessellate>\n");
 	
 	switch (altitudeMode) {
 	
 		case relativeToGround:
-			buffer_printf(buf, "  <altitudeMode>relativeToGround</altitudeMode>\n");
+			buffer_literal(buf, "  <altitudeMode>relativeToGround</altitudeMode>\n");
 			break;
 		
 		case absolute:
-			buffer_printf(buf, "  <altitudeMode>absolute</altitudeMode>\n");
+			buffer_literal(buf, "  <altitudeMode>absolute</altitudeMode>\n");
 			break;
 		
 		case clampToGround:
@@ -687,7 +1915,7 @@ void KML_linearring_header (
 			break;
 	}
 	
-	buffer_printf(buf, "  <coordinates>");
+	buffer_literal(buf, "  <coordinates>");
 	buf->indent++;
 	
 	return;
@@ -709,8 +1937,8 @@ void KML_linearring_footer (
 	buffer *buf = &(kml->buf);
 	
 	buf->indent--;
-	buffer_printf_noindent(buf, "</coordinates>\n");
-	buffer_printf(buf, "</LinearRing>\n");
+	buffer_literal_noindent(buf, "</coordinates>\n");
+	buffer_literal(buf, "</LinearRing>\n");
 
 	return;
 }
@@ -736,7 +1964,9 @@ void KML_coordinates_3d (
 {
 	buffer *buf = &(kml->buf);
 
-	buffer_printf_noindent(buf, kml->fmt3d, *x, *y, *z);
+	double values[3] = {*x, *y, *z};
+	
+	buffer_append_tuple(buf, values, 3, kml->printprec);
 	
 	return;
 }
@@ -759,7 +1989,117 @@ void KML_coordinates_2d (
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf_noindent(buf, kml->fmt2d, *x, *y);
+	double values[2] = {*x, *y};
+	
+	buffer_append_tuple(buf, values, 2, kml->printprec);
+	
+	return;
+}
+
+/*******************************************************************************
+ function to add coordinates of an array of 3d points to a kml
+ 
+ args:
+								kml					pointer to the kml struct
+								xyz					the points as x,y,z,x,y,z...
+								count				the number of points
+	
+ returns:
+								nothing
+*******************************************************************************/
+
+void KML_coordinates_3d_array (
+	KML *kml,
+	double *xyz,
+	size_t count)
+{
+	buffer *buf = &(kml->buf);
+	
+	buffer_append_tuples(buf, xyz, count, 3, kml->printprec);
+	
+	return;
+}
+
+/*******************************************************************************
+ function to add coordinates of an array of 2d points to a kml
+ 
+ args:
+								kml					pointer to the kml struct
+								xy					the points as x,y,x,y...
+								count				the number of points
+	
+ returns:
+								nothing
+*******************************************************************************/
+
+void KML_coordinates_2d_array (
+	KML *kml,
+	double *xy,
+	size_t count)
+{
+	buffer *buf = &(kml->buf);
+	
+	buffer_append_tuples(buf, xy, count, 2, kml->printprec);
+	
+	return;
+}
+
+/*******************************************************************************
+ function to add coordinates of points held in separate x, y and z arrays
+ to a kml
+ 
+ args:
+								kml					pointer to the kml struct
+								x						array of x coords
+								y						array of y coords
+								z						array of z coords or NULL for 2d
+								count				the number of points
+	
+ returns:
+								nothing
+*******************************************************************************/
+
+void KML_coordinates_soa (
+	KML *kml,
+	double *x,
+	double *y,
+	double *z,
+	size_t count)
+{
+	buffer *buf = &(kml->buf);
+	
+	buffer_append_strided(buf, x, y, z, sizeof(double), count, kml->printprec);
+	
+	return;
+}
+
+/*******************************************************************************
+ function to add coordinates of points laid out with a byte stride, such
+ as fields in an array of structs, to a kml
+ 
+ args:
+								kml					pointer to the kml struct
+								x						the x coord of the first point
+								y						the y coord of the first point
+								z						the z coord of the first point or NULL for 2d
+								stride			the number of bytes from one point to the next
+								count				the number of points
+	
+ returns:
+								nothing
+*******************************************************************************/
+
+void KML_coordinates_strided (
+	KML *kml,
+	double *x,
+	double *y,
+	double *z,
+	size_t stride,
+	size_t count)
+{
+	buffer *buf = &(kml->buf);
+	
+	buffer_append_strided(buf, x, y, z, stride, count, kml->printprec);
 	
 	return;
 }
@@ -781,10 +2121,13 @@ void KML_style_header (
 {
 	buffer *buf = &(kml->buf);
 	
-	if (id)
-		buffer_printf(buf, "<Style id=\"%s\">\n", id);
+	if (id) {
+		buffer_literal(buf, "<Style id=\"");
+		buffer_append_str(buf, id);
+		buffer_literal_noindent(buf, "\">\n");
+	}
 	else
-		buffer_printf(buf, "<Style>\n", id);
+		buffer_literal(buf, "<Style>\n");
 	buf->indent++;
 	
 	return;
@@ -806,7 +2149,34 @@ void KML_style_footer (
 	buffer *buf = &(kml->buf);
 	
 	buf->indent--;
-	buffer_printf(buf, "</Style>\n");
+	buffer_literal(buf, "</Style>\n");
+	
+	return;
+}
+
+/*******************************************************************************
+ function to add a color to a kml, kml colors are aabbggrr
+ 
+ args:
+								buf				pointer to the buffer
+								rgb				rgb value for the style
+								alpha			the alpha value for the style
+ 
+ returns:
+								nothing
+*******************************************************************************/
+
+static void KML_color (
+	buffer *buf,
+	char *rgb,
+	char *alpha)
+{
+	char color[8] = {alpha[0], alpha[1], rgb[4], rgb[5], rgb[2], rgb[3],
+									 rgb[0], rgb[1]};
+	
+	buffer_literal(buf, "  <color>");
+	buffer_append_noindent(buf, color, sizeof(color));
+	buffer_literal_noindent(buf, "</color>\n");
 	
 	return;
 }
@@ -832,11 +2202,12 @@ void KML_linestyle (
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf(buf, "<LineStyle>\n");
-	buffer_printf(buf, "  <color>%c%c%c%c%c%c%c%c</color>\n", alpha[0], alpha[1],
-								rgb[4], rgb[5], rgb[2], rgb[3], rgb[0], rgb[1]);
-	buffer_printf(buf, "  <width>%i</width>\n", width);
-	buffer_printf(buf, "</LineStyle>\n");
+	buffer_literal(buf, "<LineStyle>\n");
+	KML_color(buf, rgb, alpha);
+	buffer_literal(buf, "  <width>");
+	buffer_append_int(buf, width, 0);
+	buffer_literal_noindent(buf, "</width>\n");
+	buffer_literal(buf, "</LineStyle>\n");
 	
 	return;
 }
@@ -860,11 +2231,9 @@ void KML_polystyle (
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf(buf, "<PolyStyle>\n");
-	buffer_printf(buf, "  <color>%c%c%c%c%c%c%c%c</color>\n", alpha[0], alpha[1],
-								rgb[4], rgb[5], rgb[2],
-								rgb[3], rgb[0], rgb[1]);
-	buffer_printf(buf, "</PolyStyle>\n");
+	buffer_literal(buf, "<PolyStyle>\n");
+	KML_color(buf, rgb, alpha);
+	buffer_literal(buf, "</PolyStyle>\n");
 	
 	return;
 }
@@ -899,28 +2268,38 @@ void KML_iconstyle (
 	
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf(buf, "<IconStyle>\n");
-	buffer_printf(buf, "  <color>%c%c%c%c%c%c%c%c</color>\n", alpha[0], alpha[1],
-								rgb[4], rgb[5], rgb[2],
-								rgb[3], rgb[0], rgb[1]);
+	buffer_literal(buf, "<IconStyle>\n");
+	KML_color(buf, rgb, alpha);
 	
-	if (scale != 1.0)
-		buffer_printf(buf, "  <scale>%f</scale>\n", scale);
+	if (scale != 1.0) {
+		buffer_literal(buf, "  <scale>");
+		buffer_append_fixed(buf, scale, 6);
+		buffer_literal_noindent(buf, "</scale>\n");
+	}
 	
-	if (heading != 0)
-		buffer_printf(buf, "  <heading>%f</heading>\n", heading);
+	if (heading != 0) {
+		buffer_literal(buf, "  <heading>");
+		buffer_append_fixed(buf, heading, 6);
+		buffer_literal_noindent(buf, "</heading>\n");
+	}
 	
-	if (dx != 0.5 || dy != 0.5)
-		buffer_printf(buf, "  <hotSpot x=\"%f\" y=\"%f\" xunits=\"%s\" yunits=\"%s\"/>\n",
-									dx, dy, "fraction", "fraction");
+	if (dx != 0.5 || dy != 0.5) {
+		buffer_literal(buf, "  <hotSpot x=\"");
+		buffer_append_fixed(buf, dx, 6);
+		buffer_literal_noindent(buf, "\" y=\"");
+		buffer_append_fixed(buf, dy, 6);
+		buffer_literal_noindent(buf, "\" xunits=\"fraction\" yunits=\"fraction\"/>\n");
+	}
 	
 	if (icon) {
-		buffer_printf(buf, "  <Icon>\n");
-		buffer_printf(buf, "    <href>%s</href>\n", icon);
-		buffer_printf(buf, "  </Icon>\n");
+		buffer_literal(buf, "  <Icon>\n");
+		buffer_literal(buf, "    <href>");
+		buffer_append_str(buf, icon);
+		buffer_literal_noindent(buf, "</href>\n");
+		buffer_literal(buf, "  </Icon>\n");
 	}
 	
-	buffer_printf(buf, "</IconStyle>\n");
+	buffer_literal(buf, "</IconStyle>\n");
 	
 	return;
 }
@@ -942,11 +2321,13 @@ void KML_networklink (
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf(buf, "<NetworkLink>\n");
-	buffer_printf(buf, "  <Link>\n");
-	buffer_printf(buf, "    <href>%s</href>\n", url);
-	buffer_printf(buf, "  </Link>\n");
-	buffer_printf(buf, "</NetworkLink>\n");
+	buffer_literal(buf, "<NetworkLink>\n");
+	buffer_literal(buf, "  <Link>\n");
+	buffer_literal(buf, "    <href>");
+	buffer_append_str(buf, url);
+	buffer_literal_noindent(buf, "</href>\n");
+	buffer_literal(buf, "  </Link>\n");
+	buffer_literal(buf, "</NetworkLink>\n");
 	
 	return;
 }
@@ -966,9 +2347,9 @@ void KML_timestamp_header (
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf(buf, "<TimeStamp>\n");
+	buffer_literal(buf, "<TimeStamp>\n");
 	buf->indent++;
-	buffer_printf(buf, "<when>\n");
+	buffer_literal(buf, "<when>\n");
 	buf->indent++;
 	
 	return;
@@ -990,9 +2371,9 @@ void KML_timestamp_footer (
 	buffer *buf = &(kml->buf);
 	
 	buf->indent--;
-	buffer_printf(buf, "</when>\n");
+	buffer_literal(buf, "</when>\n");
 	buf->indent--;
-	buffer_printf(buf, "</TimeStamp>\n");
+	buffer_literal(buf, "</TimeStamp>\n");
 	
 	return;
 }
@@ -1012,7 +2393,7 @@ void KML_timespan_header (
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf(buf, "<TimeSpan>\n");
+	buffer_literal(buf, "<TimeSpan>\n");
 	buf->indent++;
 	
 	return;
@@ -1034,7 +2415,7 @@ void KML_timespan_footer (
 	buffer *buf = &(kml->buf);
 	
 	buf->indent--;
-	buffer_printf(buf, "</TimeSpan>\n");
+	buffer_literal(buf, "</TimeSpan>\n");
 	
 	return;
 }
@@ -1054,7 +2435,7 @@ void KML_begin_header (
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf(buf, "<begin>");
+	buffer_literal(buf, "<begin>");
 	
 	return;
 }
@@ -1074,7 +2455,7 @@ void KML_begin_footer (
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf_noindent(buf, "</begin>\n");
+	buffer_literal_noindent(buf, "</begin>\n");
 	
 	return;
 }
@@ -1094,7 +2475,7 @@ void KML_end_header (
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf(buf, "<end>");
+	buffer_literal(buf, "<end>");
 	
 	return;
 }
@@ -1114,7 +2495,7 @@ void KML_end_footer (
 {
 	buffer *buf = &(kml->buf);
 	
-	buffer_printf_noindent(buf, "</end>\n");
+	buffer_literal_noindent(buf, "</end>\n");
 	
 	return;
 }
@@ -1147,32 +2528,43 @@ void KML_time (
 	buffer *buf = &(kml->buf);
 	
 	if (year)
-		buffer_printf_noindent(buf, "%i", *year);
+		buffer_append_int(buf, *year, 0);
 	else
 		goto end;
 	
-	if (month)
-		buffer_printf_noindent(buf, "-%02i", *month);
+	if (month) {
+		buffer_literal_noindent(buf, "-");
+		buffer_append_int(buf, *month, 2);
+	}
 	else
 		goto end;
 
-	if (day)
-		buffer_printf_noindent(buf, "-%02i", *day);
+	if (day) {
+		buffer_literal_noindent(buf, "-");
+		buffer_append_int(buf, *day, 2);
+	}
 	else
 		goto end;
 	
-	if (hour)
-		buffer_printf_noindent(buf, "T%02i", *hour);
+	if (hour) {
+		buffer_literal_noindent(buf, "T");
+		buffer_append_int(buf, *hour, 2);
+	}
 	else
 		goto end;
 	
-	if (min)
-		buffer_printf_noindent(buf, ":%02i", *min);
+	if (min) {
+		buffer_literal_noindent(buf, ":");
+		buffer_append_int(buf, *min, 2);
+	}
 	else
 		goto end;
 	
-	if (sec)
-		buffer_printf_noindent(buf, ":%02iZ", *sec);
+	if (sec) {
+		buffer_literal_noindent(buf, ":");
+		buffer_append_int(buf, *sec, 2);
+		buffer_literal_noindent(buf, "Z");
+	}
 	else
 		goto end;
 	
@@ -1199,10 +2591,16 @@ void KML_style_url (
 {
 	buffer *buf = &(kml->buf);
 	
-	if (styleurl)
-		buffer_printf(buf, "<styleUrl>%s#%s</styleUrl>\n", styleurl, styleid);
+	if (styleurl) {
+		buffer_literal(buf, "<styleUrl>");
+		buffer_append_str(buf, styleurl);
+		buffer_literal_noindent(buf, "#");
+	}
 	else
-		buffer_printf(buf, "<styleUrl>#%s</styleUrl>\n", styleid);
+		buffer_literal(buf, "<styleUrl>#");
+	
+	buffer_append_str(buf, styleid);
+	buffer_literal_noindent(buf, "</styleUrl>\n");
 	
 	return;
 }
@@ -0,0 +1,134 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+ 
+#include <stdlib.h>
+
+#include "arena.h"
+#include "error.h"
+
+/***** default size of the first chunk, and the most chunks double to *****/
+
+#define ARENA_CHUNK (64 * 1024)
+#define ARENA_MAXCHUNK (16 * 1024 * 1024)
+
+/***** pieces are aligned for any type *****/
+
+#define ARENA_ALIGN 16
+#define ARENA_ROUND(x) (((x) + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1))
+
+/***** data starts after the header, kept aligned *****/
+
+#define ARENA_HEADER ARENA_ROUND(sizeof(arena_chunk))
+
+/*******************************************************************************
+	function to set up an arena
+
+	args:
+						a					the arena
+						chunksize	size of the first chunk or 0 for the default,
+											later chunks double in size
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void arena_init (
+	arena *a,
+	size_t chunksize)
+{
+	
+	a->chunks = NULL;
+	a->chunksize = chunksize ? chunksize : ARENA_CHUNK;
+	a->total = 0;
+	
+	return;
+}
+
+/*******************************************************************************
+	function to get memory from an arena
+
+	args:
+						a					the arena
+						size			the number of bytes needed
+	
+ returns:
+						pointer to the zeroed memory, aligned for any type
+						exit()s on error
+	
+	the arena grows by adding chunks, memory already handed out never moves
+*******************************************************************************/
+
+void *arena_alloc (
+	arena *a,
+	size_t size)
+{
+	arena_chunk *chunk = a->chunks;
+	size_t csize;
+	void *result;
+	
+	size = ARENA_ROUND(size);
+	
+	/***** a new chunk when the newest one is full *****/
+	
+	if (!chunk || chunk->size - chunk->used < size) {
+		
+		csize = a->chunksize;
+		if (csize < size)
+			csize = size;
+		
+		if (!(chunk = calloc(1, ARENA_HEADER + csize)))
+			ERROR("arena_alloc");
+		
+		chunk->next = a->chunks;
+		chunk->size = csize;
+		chunk->used = 0;
+		a->chunks = chunk;
+		a->total += csize;
+		
+		if (a->chunksize < ARENA_MAXCHUNK)
+			a->chunksize *= 2;
+	}
+	
+	result = (char *) chunk + ARENA_HEADER + chunk->used;
+	chunk->used += size;
+	
+	return result;
+}
+
+/*******************************************************************************
+	function to free all the memory of an arena
+
+	args:
+						a					the arena
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void arena_free (
+	arena *a)
+{
+	arena_chunk *chunk;
+	
+	while ((chunk = a->chunks)) {
+		a->chunks = chunk->next;
+		free(chunk);
+	}
+	
+	a->total = 0;
+	
+	return;
+}
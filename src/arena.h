@@ -0,0 +1,97 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+ 
+#ifndef _ARENA_H
+#define _ARENA_H
+
+/*******************************************************************************
+	arena chunk structure, the header of a block the arena hands out pieces of
+	
+	members:
+							next			the previous chunk
+							size			size of the data after the header
+							used			amount of the data handed out
+*******************************************************************************/
+
+typedef struct arena_chunk_s {
+	struct arena_chunk_s *next;
+	size_t size;
+	size_t used;
+} arena_chunk;
+
+/*******************************************************************************
+	arena structure, memory handed out in pieces and freed all at once
+	
+	members:
+							chunks		the newest chunk, the rest follow it
+							chunksize	size of the next chunk
+							total			bytes allocated for all chunks
+*******************************************************************************/
+
+typedef struct {
+	arena_chunk *chunks;
+	size_t chunksize;
+	size_t total;
+} arena;
+
+/*******************************************************************************
+	function to set up an arena
+
+	args:
+						a					the arena
+						chunksize	size of the first chunk or 0 for the default,
+											later chunks double in size
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void arena_init (
+	arena *a,
+	size_t chunksize);
+
+/*******************************************************************************
+	function to get memory from an arena
+
+	args:
+						a					the arena
+						size			the number of bytes needed
+	
+ returns:
+						pointer to the zeroed memory, aligned for any type
+						exit()s on error
+	
+	the arena grows by adding chunks, memory already handed out never moves
+*******************************************************************************/
+
+void *arena_alloc (
+	arena *a,
+	size_t size);
+
+/*******************************************************************************
+	function to free all the memory of an arena
+
+	args:
+						a					the arena
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void arena_free (
+	arena *a);
+
+#endif /* _ARENA_H */
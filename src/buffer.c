@@ -14,47 +14,347 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
  */
  
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <zlib.h>
 
 #include "buffer.h"
+#include "dtoa.h"
 #include "error.h"
 
 #define INDENTSPACES 2
 
 #define INITIAL 4096
+
+/***** blocks this big are mmap()ed so they grow without copying *****/
+
+#define MMAP_THRESHOLD (64 * 1024 * 1024)
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/*******************************************************************************
+	function to add the bytes of the last block not yet in the running crc
+*******************************************************************************/
+
+static void buffer_crc_update (
+	buffer *buf)
+{
+	
+	if (buf->crcon && buf->used > buf->crcused) {
+		buf->crc = crc32(buf->crc, (const Bytef *) buf->buf + buf->crcused,
+										 buf->used - buf->crcused);
+		buf->crcused = buf->used;
+	}
+	
+	return;
+}
+
+/*******************************************************************************
+	function to round a mapped block size up to whole pages
+*******************************************************************************/
+
+static size_t buffer_map_size (
+	size_t size)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	
+	return (size + page - 1) & ~(page - 1);
+}
+
+/*******************************************************************************
+	function to allocate a block, blocks of MMAP_THRESHOLD or more are mapped
+	and size is rounded up to whole pages
+*******************************************************************************/
+
+static char *buffer_new_block (
+	size_t *size)
+{
+	char *result;
+	
+	if (*size < MMAP_THRESHOLD) {
+		if (!(result = malloc (*size)))
+			ERROR("buffer_alloc");
+		
+		return result;
+	}
+	
+	*size = buffer_map_size(*size);
+	
+	result = mmap(NULL, *size, PROT_READ | PROT_WRITE,
+								MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (result == MAP_FAILED)
+		ERROR("buffer_alloc");
+	
+#ifdef MADV_HUGEPAGE
+	madvise(result, *size, MADV_HUGEPAGE);
+#endif
+	
+	return result;
+}
+
+/*******************************************************************************
+	function to free a block unless the buffer does not own it
+*******************************************************************************/
+
+static void buffer_free_block (
+	buffer *buf,
+	char *block,
+	size_t size)
+{
+	
+	if (block == buf->fixed)
+		return;
+	
+	if (size < MMAP_THRESHOLD)
+		free(block);
+	else
+		munmap(block, size);
+	
+	return;
+}
+
 /*******************************************************************************
-	function to allocate memory for a buffer
+	function to grow the block of a contiguous buffer, a block the buffer
+	does not own is copied out instead of realloc()ed and a mapped block is
+	remapped
+*******************************************************************************/
+
+static void buffer_grow_block (
+	buffer *buf,
+	size_t size)
+{
+	char *temp;
+	
+	/***** small blocks realloc() *****/
+	
+	if (buf->buf != buf->fixed && size < MMAP_THRESHOLD) {
+		if (!(temp = realloc (buf->buf, size)))
+			ERROR("buffer_alloc");
+	}
+	
+#ifdef MREMAP_MAYMOVE
+	
+	/***** mapped blocks move their pages, not their bytes *****/
+	
+	else if (buf->alloced >= MMAP_THRESHOLD) {
+		size = buffer_map_size(size);
+		
+		temp = mremap(buf->buf, buf->alloced, size, MREMAP_MAYMOVE);
+		if (temp == MAP_FAILED)
+			ERROR("buffer_alloc");
+	}
+	
+#endif
+	
+	/***** copied to a new block when crossing into mapped memory *****/
+	
+	else {
+		temp = buffer_new_block(&size);
+		memcpy(temp, buf->buf, buf->alloced);
+		buffer_free_block(buf, buf->buf, buf->alloced);
+		buf->fixed = NULL;
+	}
+	
+	buf->buf = temp;
+	buf->alloced = size;
+	
+	return;
+}
+
+/*******************************************************************************
+	function to pick the size of the first block of a buffer, a flushing
+	buffer starts no bigger than its high water mark so it is flushed there
+*******************************************************************************/
+
+static size_t buffer_first_size (
+	buffer *buf,
+	size_t need)
+{
+	size_t size = INITIAL;
+	
+	if (buf->flush && buf->highwater && size > buf->highwater)
+		size = buf->highwater;
+	if (size < need)
+		size = need;
+	
+	return size;
+}
+
+/*******************************************************************************
+	function to start a new block in a segmented buffer, the full block is
+	moved to the segment list as is
+*******************************************************************************/
+
+static void buffer_new_segment (
+	buffer *buf,
+	size_t need)
+{
+	buffer_segment *seg;
+	size_t size;
+	
+	/***** blocks double up to segsize so small buffers stay small *****/
+	
+	size = buf->alloced * 2;
+	if (size > buf->segsize)
+		size = buf->segsize;
+	if (size < need)
+		size = need;
+	
+	if (!buf->used) {
+		buffer_free_block(buf, buf->buf, buf->alloced);
+	}
+	
+	else {
+		buffer_crc_update(buf);
+		
+		if (!(seg = malloc(sizeof(buffer_segment))))
+			ERROR("buffer_alloc");
+		
+		seg->next = NULL;
+		seg->buf = buf->buf;
+		seg->alloced = buf->alloced;
+		seg->used = buf->used;
+		
+		if (buf->tail)
+			buf->tail->next = seg;
+		else
+			buf->head = seg;
+		buf->tail = seg;
+		buf->segused += seg->used;
+	}
+	
+	buf->used = 0;
+	buf->crcused = 0;
+	buf->buf = buffer_new_block(&size);
+	buf->alloced = size;
+	
+	buf->buf[0] = 0;
+	
+	return;
+}
+
+/*******************************************************************************
+	function to make sure a buffer has room to write need bytes in one piece
+
+	args:
+						buf			the buffer
+						need		the number of bytes needed
+	
+ returns:
+						nothing
+						exit()s on error
+	
+	callers check buf->alloced < buf->used + need before calling this
 *******************************************************************************/
 
 void buffer_alloc (
 	buffer *buf,
 	size_t need)
 {
-	char *temp;
+	size_t size;
 	
 	/***** if no memory alocate *****/
 
 	if (!buf->alloced) {
-		buf->alloced = INITIAL;
-		if (!(buf->buf = malloc (buf->alloced)))
-			ERROR("buffer_alloc");
+		size = buffer_first_size(buf, need);
+		buf->buf = buffer_new_block(&size);
+		buf->alloced = size;
 		
 		buf->buf[0] = 0;
 	}
+	
+	/***** hand off the content rather than grow past the high water mark *****/
+	
+	if (buf->flush && buffer_length(buf) &&
+			buffer_length(buf) + need > buf->highwater) {
+		buffer_flush(buf);
+		
+		if (buf->alloced >= need)
+			return;
+	}
+	
+	/***** segmented buffers never move what is already there *****/
+	
+	if (buf->segsize && buf->alloced < buf->used + need) {
+		buffer_new_segment(buf, need);
+		return;
+	}
 
 	/***** if not enough memory realocate *****/
+	
+	buffer_crc_update(buf);
+	
+	size = buf->alloced;
+	while (size < buf->used + need)
+		size *= 2;
+	
+	if (size != buf->alloced)
+		buffer_grow_block(buf, size);
+	
+	return;
+}
 
-	while (buf->alloced < buf->used + need) {
+/*******************************************************************************
+	function to allocate room for need more bytes in one step, rather than
+	growing there by doubling
 
-		buf->alloced *= 2;
-		if (!(temp = realloc (buf->buf, buf->alloced)))
-			ERROR("buffer_alloc");
-			
-		buf->buf = temp;
+	args:
+						buf			the buffer
+						need		the number of bytes expected
+	
+ returns:
+						nothing
+						exit()s on error
+	
+	a segmented buffer gets no more than a block and a flushing buffer no
+	more than its high water mark
+*******************************************************************************/
+
+void buffer_reserve (
+	buffer *buf,
+	size_t need)
+{
+	size_t size;
+	
+	if (buf->segsize && need > buf->segsize)
+		need = buf->segsize;
+	if (buf->flush && need > buf->highwater)
+		need = buf->highwater;
+	
+	if (buf->alloced >= buf->used + need)
+		return;
+	
+	/***** if no memory alocate *****/
+	
+	if (!buf->alloced) {
+		size = buffer_first_size(buf, need);
+		buf->buf = buffer_new_block(&size);
+		buf->alloced = size;
+		
+		buf->buf[0] = 0;
+	}
+	
+	/***** the next block of a segmented buffer is made the size asked for *****/
+	
+	else if (buf->segsize)
+		buffer_new_segment(buf, need);
+	
+	/***** realocate once to the size asked for *****/
+	
+	else {
+		buffer_crc_update(buf);
+		buffer_grow_block(buf, buf->used + need);
 	}
 	
 	return;
@@ -192,6 +492,710 @@ int buffer_printf_noindent(
 	return result;
 }
 
+/*******************************************************************************
+	function to append a string of known length to a buffer
+
+	args:
+						buf			the buffer to append to
+						str			the string to append
+						len			the length of the string not includeing the \0
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_append(
+	buffer *buf,
+	const char *str,
+	size_t len)
+{
+	size_t spaces = 0;
+	size_t need;
+	
+	/***** an unbalanced footer leaves the indent negative, print no spaces *****/
+	
+	if (buf->indent > 0)
+		spaces = buf->indent * INDENTSPACES;
+	need = spaces + len + 1;
+	
+	if (buf->alloced < buf->used + need) {
+		
+		/***** long strings are split over blocks in a segmented buffer *****/
+		
+		if (buf->segsize && len > spaces) {
+			if (buf->alloced < buf->used + spaces + 1)
+				buffer_alloc(buf, spaces + 1);
+			
+			memset(buf->buf + buf->used, ' ', spaces);
+			buf->used += spaces;
+			
+			buffer_append_noindent(buf, str, len);
+			
+			return;
+		}
+		
+		buffer_alloc(buf, need);
+	}
+	
+	memset(buf->buf + buf->used, ' ', spaces);
+	buf->used += spaces;
+	
+	memcpy(buf->buf + buf->used, str, len);
+	buf->used += len;
+	buf->buf[buf->used] = '\0';
+	
+	return;
+}
+
+/*******************************************************************************
+	function to append a string of known length to a buffer with no indent
+
+	args:
+						buf			the buffer to append to
+						str			the string to append
+						len			the length of the string not includeing the \0
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_append_noindent(
+	buffer *buf,
+	const char *str,
+	size_t len)
+{
+	
+	if (buf->alloced < buf->used + len + 1) {
+		
+		/***** fill the rest of the block before starting a new one *****/
+		
+		if (buf->segsize && buf->alloced > buf->used + 1) {
+			size_t room = buf->alloced - buf->used - 1;
+			
+			memcpy(buf->buf + buf->used, str, room);
+			buf->used += room;
+			str += room;
+			len -= room;
+		}
+		
+		buffer_alloc(buf, len + 1);
+	}
+	
+	memcpy(buf->buf + buf->used, str, len);
+	buf->used += len;
+	buf->buf[buf->used] = '\0';
+	
+	return;
+}
+
+/*******************************************************************************
+	function to append a \0 terminated string to a buffer with no indent
+
+	args:
+						buf			the buffer to append to
+						str			the string to append
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_append_str(
+	buffer *buf,
+	const char *str)
+{
+	
+	buffer_append_noindent(buf, str, strlen(str));
+	
+	return;
+}
+
+/*******************************************************************************
+	function to append an integer to a buffer with no indent
+
+	args:
+						buf			the buffer to append to
+						value		the value to append
+						width		minimum number of digits, zero padded, or 0
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_append_int(
+	buffer *buf,
+	long value,
+	int width)
+{
+	char digits[24];
+	char *p = digits + sizeof(digits);
+	unsigned long u = value < 0 ? -(unsigned long)value : (unsigned long)value;
+	int sign = value < 0;
+	int len;
+	int pad;
+	
+	/***** digits are made backwards *****/
+	
+	do {
+		*(--p) = '0' + u % 10;
+		u /= 10;
+	} while (u);
+	
+	len = digits + sizeof(digits) - p;
+	
+	/***** the width includes the sign, as with %0*ld *****/
+	
+	pad = width - sign;
+	if (pad < len)
+		pad = len;
+	
+	/***** sign, padding and digits in one go *****/
+	
+	if (buf->alloced < buf->used + sign + pad + 1)
+		buffer_alloc(buf, sign + pad + 1);
+	
+	if (sign)
+		buf->buf[buf->used++] = '-';
+	
+	for ( ; pad > len ; pad--)
+		buf->buf[buf->used++] = '0';
+	
+	memcpy(buf->buf + buf->used, p, len);
+	buf->used += len;
+	buf->buf[buf->used] = '\0';
+	
+	return;
+}
+
+/*******************************************************************************
+	function to append a double to a buffer with no indent, same output as %.*lg
+
+	args:
+						buf			the buffer to append to
+						value		the value to append
+						prec		the number of significant digits or DTOA_SHORTEST
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_append_double(
+	buffer *buf,
+	double value,
+	int prec)
+{
+	size_t need = DTOA_SIZE(prec);
+	
+	if (buf->alloced < buf->used + need)
+		buffer_alloc(buf, need);
+	
+	buf->used += dtoa(buf->buf + buf->used, value, prec);
+	buf->buf[buf->used] = '\0';
+	
+	return;
+}
+
+/*******************************************************************************
+	function to append a coordinate tuple to a buffer with no indent,
+	the values are comma separated and followed by a space
+
+	args:
+						buf			the buffer to append to
+						values	the values to append
+						count		the number of values
+						prec		the number of significant digits or DTOA_SHORTEST
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_append_tuple(
+	buffer *buf,
+	const double *values,
+	int count,
+	int prec)
+{
+	
+	buffer_append_tuples(buf, values, 1, count, prec);
+	
+	return;
+}
+
+/*******************************************************************************
+	function to append an array of coordinate tuples to a buffer with no indent
+
+	args:
+						buf			the buffer to append to
+						values	the values, count tuples of dims interleaved values
+						count		the number of tuples
+						dims		the number of values in each tuple
+						prec		the number of significant digits or DTOA_SHORTEST
+	
+ returns:
+						nothing
+	
+*******************************************************************************/
+
+void buffer_append_tuples(
+	buffer *buf,
+	const double *values,
+	size_t count,
+	int dims,
+	int prec)
+{
+	size_t stride = dims * sizeof(double);
+	
+	if (dims == 1)
+		buffer_append_strided(buf, values, NULL, NULL, stride, count, prec);
+	else if (dims == 2)
+		buffer_append_strided(buf, values, values + 1, NULL, stride, count, prec);
+	else
+		buffer_append_strided(buf, values, values + 1, values + 2, stride, count,
+													prec);
+	
+	return;
+}
+
+/*******************************************************************************
+	function to append coordinate tuples to a buffer with no indent, reading
+	each axis through its own pointer and a common byte stride
+
+	args:
+						buf			the buffer to append to
+						x				the first x value
+						y				the first y value or NULL for 1d
+						z				the first z value or NULL for 2d
+						stride	the number of bytes from one point to the next
+						count		the number of tuples
+						prec		the number of significant digits or DTOA_SHORTEST
+	
+ returns:
+						nothing
+	
+	space is reserved once per run of TUPLERUN tuples rather than per value
+*******************************************************************************/
+
+#define TUPLERUN 1024
+
+void buffer_append_strided(
+	buffer *buf,
+	const double *x,
+	const double *y,
+	const double *z,
+	size_t stride,
+	size_t count,
+	int prec)
+{
+	const char *px = (const char *) x;
+	const char *py = (const char *) y;
+	const char *pz = (const char *) z;
+	size_t tuplesize = (1 + (y != NULL) + (z != NULL)) * DTOA_SIZE(prec);
+	
+	while (count > 0) {
+		size_t run = count < TUPLERUN ? count : TUPLERUN;
+		size_t need;
+		size_t i;
+		char *p;
+		
+		/***** in a segmented buffer use up the block before starting another *****/
+		
+		if (buf->segsize && buf->alloced > buf->used + tuplesize + 1 &&
+				buf->alloced < buf->used + run * tuplesize + 1)
+			run = (buf->alloced - buf->used - 1) / tuplesize;
+		
+		need = run * tuplesize + 1;
+		
+		if (buf->alloced < buf->used + need)
+			buffer_alloc(buf, need);
+		
+		p = buf->buf + buf->used;
+		
+		for (i = 0 ; i < run ; i++) {
+			p += dtoa(p, *(const double *) px, prec);
+			px += stride;
+			
+			if (py) {
+				*p++ = ',';
+				p += dtoa(p, *(const double *) py, prec);
+				py += stride;
+			}
+			
+			if (pz) {
+				*p++ = ',';
+				p += dtoa(p, *(const double *) pz, prec);
+				pz += stride;
+			}
+			
+			*p++ = ' ';
+		}
+		
+		*p = '\0';
+		buf->used = p - buf->buf;
+		count -= run;
+	}
+	
+	return;
+}
+
+/*******************************************************************************
+	function to append a double to a buffer with no indent, same output as %.*f
+
+	args:
+						buf			the buffer to append to
+						value		the value to append
+						prec		the number of digits after the decimal point
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_append_fixed(
+	buffer *buf,
+	double value,
+	int prec)
+{
+	char temp[64];
+	int len;
+	
+	/***** the integer part of a %f is not bounded, so use a scratch area *****/
+	
+	len = snprintf(temp, sizeof(temp), "%.*f", prec, value);
+	
+	if (len < sizeof(temp))
+		buffer_append_noindent(buf, temp, len);
+	
+	else {
+		if (buf->alloced < buf->used + len + 1)
+			buffer_alloc(buf, len + 1);
+		
+		buf->used += snprintf(buf->buf + buf->used, len + 1, "%.*f", prec, value);
+	}
+	
+	return;
+}
+
+/*******************************************************************************
+	function to make a buffer segmented
+
+	args:
+						buf				the buffer
+						segsize		the size of the blocks or 0 for one contiguous buffer
+	
+ returns:
+						nothing
+
+	can be called at any time, the bytes already in the buffer are not moved
+*******************************************************************************/
+
+void buffer_set_segsize(
+	buffer *buf,
+	size_t segsize)
+{
+	
+	buf->segsize = segsize;
+	
+	return;
+}
+
+/*******************************************************************************
+	function to have a buffer hand off its content instead of growing
+
+	args:
+						buf				the buffer
+						flush			function the content is handed to or NULL for none
+						extra			pointer passed on to flush
+						highwater	the content is flushed before the buffer would
+											grow past this many bytes
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_set_flush(
+	buffer *buf,
+	buffer_segment_func flush,
+	void *extra,
+	size_t highwater)
+{
+	
+	buf->flush = flush;
+	buf->flush_extra = extra;
+	buf->highwater = highwater;
+	
+	/***** an empty block bigger than that is dropped so the next one fits *****/
+	
+	if (flush && highwater && !buffer_length(buf) && buf->alloced > highwater) {
+		buffer_free_block(buf, buf->buf, buf->alloced);
+		buf->buf = NULL;
+		buf->alloced = 0;
+		buf->used = 0;
+		buf->crcused = 0;
+	}
+	
+	return;
+}
+
+/*******************************************************************************
+	function to have a buffer keep a running crc32 of everything added to it,
+	summed a block at a time while the block is still in cache
+
+	args:
+						buf				the buffer, nothing is in it yet
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_set_crc(
+	buffer *buf)
+{
+	
+	buf->crcon = 1;
+	buf->crc = crc32(0L, Z_NULL, 0);
+	buf->crcused = 0;
+	
+	return;
+}
+
+/*******************************************************************************
+	function to give an empty buffer its first block from memory it does not
+	own, such as an arena
+
+	args:
+						buf				the buffer, nothing is in it yet
+						block			the block
+						size			the size of the block
+	
+ returns:
+						nothing
+	
+	the block is never realloc()ed or free()d, a buffer that outgrows it moves
+	on to blocks of its own
+*******************************************************************************/
+
+void buffer_set_block(
+	buffer *buf,
+	char *block,
+	size_t size)
+{
+	
+	buf->buf = block;
+	buf->alloced = size;
+	buf->fixed = block;
+	
+	buf->buf[0] = '\0';
+	
+	return;
+}
+
+/*******************************************************************************
+	function to get the crc32 of everything added to a buffer with a running
+	crc, flushed content included
+
+	args:
+						buf				the buffer
+	
+ returns:
+						the crc32
+*******************************************************************************/
+
+unsigned long buffer_crc(
+	buffer *buf)
+{
+	
+	buffer_crc_update(buf);
+	
+	return buf->crc;
+}
+
+/*******************************************************************************
+	function to hand the content of a buffer to its flush function and empty it
+
+	args:
+						buf				the buffer
+	
+ returns:
+						nothing
+						exit()s on error
+*******************************************************************************/
+
+void buffer_flush(
+	buffer *buf)
+{
+	buffer_segment *seg;
+	
+	if (!buf->flush)
+		return;
+	
+	buffer_crc_update(buf);
+	
+	if (buffer_iterate(buf, buf->flush, buf->flush_extra))
+		ERROR("buffer_flush");
+	
+	/***** keep the last block to write on *****/
+	
+	while ((seg = buf->head)) {
+		buf->head = seg->next;
+		buffer_free_block(buf, seg->buf, seg->alloced);
+		free(seg);
+	}
+	
+	buf->tail = NULL;
+	buf->segused = 0;
+	buf->used = 0;
+	buf->crcused = 0;
+	if (buf->alloced)
+		buf->buf[0] = '\0';
+	
+	return;
+}
+
+/*******************************************************************************
+	function to get the number of bytes in a buffer
+
+	args:
+						buf			the buffer
+	
+ returns:
+						the number of bytes in the buffer, not includeing the \0
+*******************************************************************************/
+
+size_t buffer_length(
+	buffer *buf)
+{
+	
+	return buf->segused + buf->used;
+}
+
+/*******************************************************************************
+	function to call a function for each segment of a buffer, in order
+
+	args:
+						buf			the buffer
+						func		the function to call
+						extra		pointer passed on to func
+	
+ returns:
+						0 if every segment was visited, else what func returned
+*******************************************************************************/
+
+int buffer_iterate(
+	buffer *buf,
+	buffer_segment_func func,
+	void *extra)
+{
+	buffer_segment *seg;
+	int result;
+	
+	for (seg = buf->head ; seg ; seg = seg->next) {
+		if ((result = func(seg->buf, seg->used, extra)))
+			return result;
+	}
+	
+	if (buf->used)
+		return func(buf->buf, buf->used, extra);
+	
+	return 0;
+}
+
+/*******************************************************************************
+	function to write a buffer to a file descriptor
+
+	args:
+						buf			the buffer
+						fd			the file descriptor to write to
+	
+ returns:
+						0 on success
+						-1 on error with errno set
+*******************************************************************************/
+
+int buffer_write_fd(
+	buffer *buf,
+	int fd)
+{
+	struct iovec iov[IOV_MAX];
+	buffer_segment *seg = buf->head;
+	int last = 0;
+	
+	while (!last) {
+		int iovcnt = 0;
+		int i;
+		
+		/***** gather as many segments as writev takes *****/
+		
+		for ( ; seg && iovcnt < IOV_MAX ; seg = seg->next, iovcnt++) {
+			iov[iovcnt].iov_base = seg->buf;
+			iov[iovcnt].iov_len = seg->used;
+		}
+		
+		if (!seg && iovcnt < IOV_MAX) {
+			iov[iovcnt].iov_base = buf->buf;
+			iov[iovcnt].iov_len = buf->used;
+			iovcnt++;
+			last = 1;
+		}
+		
+		/***** writev can stop short *****/
+		
+		for (i = 0 ; i < iovcnt ; ) {
+			ssize_t written = writev(fd, iov + i, iovcnt - i);
+			
+			if (written < 0) {
+				if (errno == EINTR)
+					continue;
+				return -1;
+			}
+			
+			while (i < iovcnt && (size_t) written >= iov[i].iov_len) {
+				written -= iov[i].iov_len;
+				i++;
+			}
+			
+			if (i < iovcnt) {
+				iov[i].iov_base = (char *) iov[i].iov_base + written;
+				iov[i].iov_len -= written;
+			}
+		}
+	}
+	
+	return 0;
+}
+
+/*******************************************************************************
+	function to empty a buffer but keep the memory it has grown to, the last
+	block of a segmented buffer is kept
+
+	args:
+						buf			the buffer to empty
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_reset(
+	buffer *buf)
+{
+	buffer_segment *seg;
+	
+	while ((seg = buf->head)) {
+		buf->head = seg->next;
+		buffer_free_block(buf, seg->buf, seg->alloced);
+		free(seg);
+	}
+	
+	buf->tail = NULL;
+	buf->segused = 0;
+	buf->used = 0;
+	buf->indent = 0;
+	if (buf->alloced)
+		buf->buf[0] = '\0';
+	
+	if (buf->crcon)
+		buffer_set_crc(buf);
+	
+	return;
+}
+
 /*******************************************************************************
 	function to free a buffer
 
@@ -205,8 +1209,15 @@ int buffer_printf_noindent(
 void buffer_free(
 	buffer *buf)
 {
+	buffer_segment *seg;
+	
+	while ((seg = buf->head)) {
+		buf->head = seg->next;
+		buffer_free_block(buf, seg->buf, seg->alloced);
+		free(seg);
+	}
 	
-	free(buf->buf);
+	buffer_free_block(buf, buf->buf, buf->alloced);
 	
 	return;
 }
@@ -17,13 +17,61 @@
 #ifndef _BUFFER_H
 #define _BUFFER_H
 
+/*******************************************************************************
+	buffer segment structure, a full block of a segmented buffer
+	
+	members:
+							next			the next segment
+							buf				the block
+							alloced		amount of space allocated in the block
+							used			amount of space used in the block
+*******************************************************************************/
+
+typedef struct buffer_segment_s {
+	struct buffer_segment_s *next;
+	char *buf;
+	size_t alloced;
+	size_t used;
+} buffer_segment;
+
+/*******************************************************************************
+	function called for each segment of a buffer
+
+	args:
+						data		the segment
+						len			the number of bytes in the segment
+						extra		the extra pointer passed to buffer_iterate
+	
+ returns:
+						0 to continue, anything else stops the iteration
+*******************************************************************************/
+
+typedef int (*buffer_segment_func) (
+	const char *data,
+	size_t len,
+	void *extra);
+
 /*******************************************************************************
 	buffer structure
 	
 	members:
-							buf				the buffer
+							buf				the buffer, in a segmented buffer the last block
 							alloced		amount of space allocated in the buffer
 							used			amount of space used in the buffer
+							segsize		0 for one contiguous buffer that grows with
+												realloc, else the size of the blocks
+							head			the first full block of a segmented buffer
+							tail			the last full block of a segmented buffer
+							segused		amount of space used in the full blocks
+							flush			function the content is handed to before the
+												buffer would grow past highwater, or NULL
+							flush_extra	pointer passed on to flush
+							highwater	size the buffer is flushed at
+							crcon			flag to keep a running crc32 of the content
+							crc				crc32 of the content summed so far
+							crcused		bytes of the last block already in crc
+							fixed			a block the buffer was given and does not own, or
+												NULL
 *******************************************************************************/
 
 typedef struct {
@@ -31,8 +79,57 @@ typedef struct {
 	size_t alloced;
 	size_t used;
 	int indent;
+	size_t segsize;
+	buffer_segment *head;
+	buffer_segment *tail;
+	size_t segused;
+	buffer_segment_func flush;
+	void *flush_extra;
+	size_t highwater;
+	int crcon;
+	unsigned long crc;
+	size_t crcused;
+	char *fixed;
 } buffer;
 
+/*******************************************************************************
+	function to make sure a buffer has room to write need bytes in one piece
+
+	args:
+						buf			the buffer
+						need		the number of bytes needed
+	
+ returns:
+						nothing
+						exit()s on error
+	
+	callers check buf->alloced < buf->used + need before calling this
+*******************************************************************************/
+
+void buffer_alloc (
+	buffer *buf,
+	size_t need);
+
+/*******************************************************************************
+	function to allocate room for need more bytes in one step, rather than
+	growing there by doubling
+
+	args:
+						buf			the buffer
+						need		the number of bytes expected
+	
+ returns:
+						nothing
+						exit()s on error
+	
+	a segmented buffer gets no more than a block and a flushing buffer no
+	more than its high water mark
+*******************************************************************************/
+
+void buffer_reserve (
+	buffer *buf,
+	size_t need);
+
 /*******************************************************************************
 	function to print to a buffer
 
@@ -67,6 +164,344 @@ int buffer_printf_noindent(
 	char *format,
 	...);
 
+/*******************************************************************************
+	function to append a string of known length to a buffer
+
+	args:
+						buf			the buffer to append to
+						str			the string to append
+						len			the length of the string not includeing the \0
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_append(
+	buffer *buf,
+	const char *str,
+	size_t len);
+
+/*******************************************************************************
+	function to append a string of known length to a buffer with no indent
+
+	args:
+						buf			the buffer to append to
+						str			the string to append
+						len			the length of the string not includeing the \0
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_append_noindent(
+	buffer *buf,
+	const char *str,
+	size_t len);
+
+/*******************************************************************************
+	macros to append a string literal to a buffer, the length is taken at
+	compile time
+*******************************************************************************/
+
+#define buffer_literal(buf, str) \
+	buffer_append((buf), (str), sizeof(str) - 1)
+
+#define buffer_literal_noindent(buf, str) \
+	buffer_append_noindent((buf), (str), sizeof(str) - 1)
+
+/*******************************************************************************
+	function to append a \0 terminated string to a buffer with no indent
+
+	args:
+						buf			the buffer to append to
+						str			the string to append
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_append_str(
+	buffer *buf,
+	const char *str);
+
+/*******************************************************************************
+	function to append an integer to a buffer with no indent
+
+	args:
+						buf			the buffer to append to
+						value		the value to append
+						width		minimum number of digits, zero padded, or 0
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_append_int(
+	buffer *buf,
+	long value,
+	int width);
+
+/*******************************************************************************
+	function to append a double to a buffer with no indent, same output as %.*lg
+
+	args:
+						buf			the buffer to append to
+						value		the value to append
+						prec		the number of significant digits or DTOA_SHORTEST
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_append_double(
+	buffer *buf,
+	double value,
+	int prec);
+
+/*******************************************************************************
+	function to append a coordinate tuple to a buffer with no indent,
+	the values are comma separated and followed by a space
+
+	args:
+						buf			the buffer to append to
+						values	the values to append
+						count		the number of values
+						prec		the number of significant digits or DTOA_SHORTEST
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_append_tuple(
+	buffer *buf,
+	const double *values,
+	int count,
+	int prec);
+
+/*******************************************************************************
+	function to append an array of coordinate tuples to a buffer with no indent
+
+	args:
+						buf			the buffer to append to
+						values	the values, count tuples of dims interleaved values
+						count		the number of tuples
+						dims		the number of values in each tuple
+						prec		the number of significant digits or DTOA_SHORTEST
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_append_tuples(
+	buffer *buf,
+	const double *values,
+	size_t count,
+	int dims,
+	int prec);
+
+/*******************************************************************************
+	function to append coordinate tuples to a buffer with no indent, reading
+	each axis through its own pointer and a common byte stride
+
+	args:
+						buf			the buffer to append to
+						x				the first x value
+						y				the first y value or NULL for 1d
+						z				the first z value or NULL for 2d
+						stride	the number of bytes from one point to the next
+						count		the number of tuples
+						prec		the number of significant digits or DTOA_SHORTEST
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_append_strided(
+	buffer *buf,
+	const double *x,
+	const double *y,
+	const double *z,
+	size_t stride,
+	size_t count,
+	int prec);
+
+/*******************************************************************************
+	function to append a double to a buffer with no indent, same output as %.*f
+
+	args:
+						buf			the buffer to append to
+						value		the value to append
+						prec		the number of digits after the decimal point
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_append_fixed(
+	buffer *buf,
+	double value,
+	int prec);
+
+/*******************************************************************************
+	function to make a buffer segmented
+
+	args:
+						buf				the buffer
+						segsize		the size of the blocks or 0 for one contiguous buffer
+	
+ returns:
+						nothing
+
+	can be called at any time, the bytes already in the buffer are not moved
+*******************************************************************************/
+
+void buffer_set_segsize(
+	buffer *buf,
+	size_t segsize);
+
+/*******************************************************************************
+	function to have a buffer hand off its content instead of growing
+
+	args:
+						buf				the buffer
+						flush			function the content is handed to or NULL for none
+						extra			pointer passed on to flush
+						highwater	the content is flushed before the buffer would
+											grow past this many bytes
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_set_flush(
+	buffer *buf,
+	buffer_segment_func flush,
+	void *extra,
+	size_t highwater);
+
+/*******************************************************************************
+	function to have a buffer keep a running crc32 of everything added to it,
+	summed a block at a time while the block is still in cache
+
+	args:
+						buf				the buffer, nothing is in it yet
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_set_crc(
+	buffer *buf);
+
+/*******************************************************************************
+	function to give an empty buffer its first block from memory it does not
+	own, such as an arena
+
+	args:
+						buf				the buffer, nothing is in it yet
+						block			the block
+						size			the size of the block
+	
+ returns:
+						nothing
+	
+	the block is never realloc()ed or free()d, a buffer that outgrows it moves
+	on to blocks of its own
+*******************************************************************************/
+
+void buffer_set_block(
+	buffer *buf,
+	char *block,
+	size_t size);
+
+/*******************************************************************************
+	function to get the crc32 of everything added to a buffer with a running
+	crc, flushed content included
+
+	args:
+						buf				the buffer
+	
+ returns:
+						the crc32
+*******************************************************************************/
+
+unsigned long buffer_crc(
+	buffer *buf);
+
+/*******************************************************************************
+	function to hand the content of a buffer to its flush function and empty it
+
+	args:
+						buf				the buffer
+	
+ returns:
+						nothing
+						exit()s on error
+*******************************************************************************/
+
+void buffer_flush(
+	buffer *buf);
+
+/*******************************************************************************
+	function to get the number of bytes in a buffer
+
+	args:
+						buf			the buffer
+	
+ returns:
+						the number of bytes in the buffer, not includeing the \0
+*******************************************************************************/
+
+size_t buffer_length(
+	buffer *buf);
+
+/*******************************************************************************
+	function to call a function for each segment of a buffer, in order
+
+	args:
+						buf			the buffer
+						func		the function to call
+						extra		pointer passed on to func
+	
+ returns:
+						0 if every segment was visited, else what func returned
+*******************************************************************************/
+
+int buffer_iterate(
+	buffer *buf,
+	buffer_segment_func func,
+	void *extra);
+
+/*******************************************************************************
+	function to write a buffer to a file descriptor
+
+	args:
+						buf			the buffer
+						fd			the file descriptor to write to
+	
+ returns:
+						0 on success
+						-1 on error with errno set
+*******************************************************************************/
+
+int buffer_write_fd(
+	buffer *buf,
+	int fd);
+
+/*******************************************************************************
+	function to empty a buffer but keep the memory it has grown to, the last
+	block of a segmented buffer is kept
+
+	args:
+						buf			the buffer to empty
+	
+ returns:
+						nothing
+*******************************************************************************/
+
+void buffer_reset(
+	buffer *buf);
+
 /*******************************************************************************
 	function to free a buffer
 
@@ -0,0 +1,299 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <stdint.h>
+
+#include "dtoa.h"
+
+/***** most digits that fit in the 53 bit mantissa without loss *****/
+
+#define FASTDIGITS 15
+
+/***** powers of ten that are exact in a double *****/
+
+static const double pow10tab[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+	1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+	1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define MAXPOW10 22
+
+/***** two digits at a time, 00 - 99 *****/
+
+static const char digitpairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+/*******************************************************************************
+	function to get the decimal digits of a double
+
+	args:
+						value		the absolute value, finite and not zero
+						prec		the number of significant digits 1 - FASTDIGITS
+						digits	where to store the prec digits
+						exp			where to store the decimal exponent of the first digit
+	
+ returns:
+						1 on success
+						0 if the result could not be proven correctly rounded
+	
+	the value is scaled by an exact power of ten with one rounding, so the
+	scaled value is off by at most half an ulp.  the only thing that can go
+	wrong is rounding when the fraction sits on .5, those are left to printf
+*******************************************************************************/
+
+static int dtoa_digits(
+	double value,
+	int prec,
+	char *digits,
+	int *exp)
+{
+	int e = (int) floor(log10(value));
+	int tries;
+	
+	for (tries = 0 ; tries < 3 ; tries++) {
+		int scale = prec - 1 - e;
+		double scaled;
+		double whole;
+		double half;
+		uint64_t n;
+		int i;
+		
+		if (scale > MAXPOW10 || scale < -MAXPOW10)
+			return 0;
+		
+		if (scale >= 0)
+			scaled = value * pow10tab[scale];
+		else
+			scaled = value / pow10tab[-scale];
+		
+		/***** log10 was off by one *****/
+		
+		if (scaled < pow10tab[prec - 1]) {
+			e--;
+			continue;
+		}
+		if (scaled >= pow10tab[prec]) {
+			e++;
+			continue;
+		}
+		
+		/***** round half even on the exact value *****/
+		
+		whole = floor(scaled);
+		half = scaled - whole - 0.5;
+		
+		if (fabs(half) <= scaled * 0x1p-52)
+			return 0;
+		
+		n = (uint64_t) whole;
+		if (half > 0)
+			n++;
+		
+		/***** 9.99 rounding up to 10.0 *****/
+		
+		if (n == (uint64_t) pow10tab[prec]) {
+			n /= 10;
+			e++;
+		}
+		
+		for (i = prec - 2 ; i >= 0 ; i -= 2) {
+			memcpy(digits + i, digitpairs + 2 * (n % 100), 2);
+			n /= 100;
+		}
+		if (i == -1)
+			digits[0] = '0' + n;
+		
+		*exp = e;
+		
+		return 1;
+	}
+	
+	return 0;
+}
+
+/*******************************************************************************
+	function to lay out digits the way %g does
+
+	args:
+						out			where to print
+						neg			1 if there is a minus sign
+						digits	the significant digits
+						prec		the number of significant digits
+						exp			the decimal exponent of the first digit
+	
+ returns:
+						the number of chars printed
+*******************************************************************************/
+
+static int dtoa_layout(
+	char *out,
+	int neg,
+	const char *digits,
+	int prec,
+	int exp)
+{
+	char *p = out;
+	int ndigits = prec;
+	
+	if (neg)
+		*p++ = '-';
+	
+	/***** %g drops trailing zeros *****/
+	
+	while (ndigits > 1 && digits[ndigits - 1] == '0')
+		ndigits--;
+	
+	/***** d.ddde+xx *****/
+	
+	if (exp < -4 || exp >= prec) {
+		*p++ = digits[0];
+		if (ndigits > 1) {
+			*p++ = '.';
+			memcpy(p, digits + 1, ndigits - 1);
+			p += ndigits - 1;
+		}
+		
+		*p++ = 'e';
+		if (exp < 0) {
+			*p++ = '-';
+			exp = -exp;
+		}
+		else
+			*p++ = '+';
+		
+		if (exp >= 100)
+			*p++ = '0' + exp / 100;
+		*p++ = '0' + exp / 10 % 10;
+		*p++ = '0' + exp % 10;
+	}
+	
+	/***** 0.000ddd *****/
+	
+	else if (exp < 0) {
+		*p++ = '0';
+		*p++ = '.';
+		memset(p, '0', -exp - 1);
+		p += -exp - 1;
+		memcpy(p, digits, ndigits);
+		p += ndigits;
+	}
+	
+	/***** ddd.ddd *****/
+	
+	else {
+		memcpy(p, digits, exp + 1);
+		p += exp + 1;
+		if (ndigits > exp + 1) {
+			*p++ = '.';
+			memcpy(p, digits + exp + 1, ndigits - exp - 1);
+			p += ndigits - exp - 1;
+		}
+	}
+	
+	return p - out;
+}
+
+/*******************************************************************************
+	function to print a double at a fixed precision, same output as %.*lg
+
+	args:
+						out			where to print, must hold DTOA_SIZE(prec) chars
+						value		the value to print
+						prec		the number of significant digits
+	
+ returns:
+						the number of chars printed, not includeing the \0
+*******************************************************************************/
+
+static int dtoa_prec(
+	char *out,
+	double value,
+	int prec)
+{
+	char digits[FASTDIGITS];
+	int exp;
+	
+	if (prec == 0)
+		prec = 1;
+	
+	if (prec <= FASTDIGITS && isfinite(value) && value != 0 &&
+			dtoa_digits(fabs(value), prec, digits, &exp))
+		return dtoa_layout(out, signbit(value) != 0, digits, prec, exp);
+	
+	/***** zero, inf, nan, huge precisions and .5 ties *****/
+	
+	return snprintf(out, DTOA_SIZE(prec), "%.*g", prec, value);
+}
+
+/*******************************************************************************
+	function to print a double, same output as %.*lg
+
+	args:
+						out			where to print, must hold DTOA_SIZE(prec) chars
+						value		the value to print
+						prec		the number of significant digits or DTOA_SHORTEST
+	
+ returns:
+						the number of chars printed, not includeing the \0
+						out is not \0 terminated
+	
+	DTOA_SHORTEST uses the fewest digits that read back as the same double,
+	anything up to 15 digits is exact at 15, otherwise 16 or 17 are needed.
+	denormals carry fewer digits so they are searched from 1
+*******************************************************************************/
+
+int dtoa(
+	char *out,
+	double value,
+	int prec)
+{
+	char temp[DTOA_SIZE(17)];
+	int len;
+	
+	if (prec >= 0)
+		return dtoa_prec(out, value, prec);
+	
+	if (!isfinite(value))
+		return dtoa_prec(out, value, 17);
+	
+	for (prec = fabs(value) < DBL_MIN ? 1 : 15 ; prec < 17 ; prec++) {
+		len = dtoa_prec(temp, value, prec);
+		temp[len] = '\0';
+		
+		if (strtod(temp, NULL) == value) {
+			memcpy(out, temp, len);
+			return len;
+		}
+	}
+	
+	return dtoa_prec(out, value, 17);
+}
+
@@ -0,0 +1,54 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+ 
+#ifndef _DTOA_H
+#define _DTOA_H
+
+/*******************************************************************************
+	precision that selects the shortest string that reads back as the same
+	double
+*******************************************************************************/
+
+#define DTOA_SHORTEST (-1)
+
+/*******************************************************************************
+	space needed for a double printed at prec, including the \0
+
+	sign, point, e-308 and the \0 is the most %g adds to the digits
+*******************************************************************************/
+
+#define DTOA_SIZE(prec) (((prec) < 0 ? 17 : (prec) == 0 ? 1 : (prec)) + 9)
+
+/*******************************************************************************
+	function to print a double, same output as %.*lg
+
+	args:
+						out			where to print, must hold DTOA_SIZE(prec) chars
+						value		the value to print
+						prec		the number of significant digits or DTOA_SHORTEST
+	
+ returns:
+						the number of chars printed, not includeing the \0
+						out is not \0 terminated
+*******************************************************************************/
+
+int dtoa(
+	char *out,
+	double value,
+	int prec);
+
+#endif /* _DTOA_H */
+
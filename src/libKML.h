@@ -17,12 +17,27 @@
 #ifndef _LIBKML_H
 #define _LIBKML_H
 
+#include <stddef.h>
+
 enum {
 	clampToGround,
 	relativeToGround,
 	absolute
 } KML_altitudeModeEnum;
 
+/***** printprec for the shortest coordinates that read back exactly *****/
+
+#define KML_PREC_SHORTEST (-1)
+
+/***** default bytes a streaming kml holds before writing them out *****/
+
+#define KML_STREAM_HIGHWATER (1024 * 1024)
+
+/***** compression methods for KMZ_set_compression and KML_set_compression *****/
+
+#define KML_STORED 0
+#define KML_DEFLATED 8
+
 #ifndef MAKING_KML_C
 
 typedef void KMZ;
@@ -41,12 +56,71 @@ typedef void KML;
 KMZ *KMZ_new(
 	char *kmzfile);
 
+/*****************************************************************************//**
+ function to create a new kmz that adds to an existing kmz file
+ 
+ @param kmzfile			the full path of the kmz file, it is created if it
+										does not exist
+ 
+ @return	pointer to the KMZ struct
+
+ KMZ_write() leaves the entries already in the file where they are, writes
+ the new kmls after them and rewrites only the central directory, so the
+ cost is that of the new data. a kml with the same name as an existing
+ entry is an error, use KMZ_update() to replace entries.
+*******************************************************************************/
+
+KMZ *KMZ_open_append(
+	char *kmzfile);
+
+/*****************************************************************************//**
+ function to have the kmls of a kmz compressed as they are made
+ 
+ @param kmz					pointer to the kmz struct
+ @param highwater		kmls are compressed whenever this many bytes are
+										waiting, or 0 to compress them in KMZ_write
+
+ @return	nothing
+
+ applies to kmls created with KML_new() after this call. each kml is also
+ compressed when its footer is added, so the kmz only holds compressed
+ data. such kmls are only written by KMZ_write(), not KML_write().
+ KMZ_write() finishes their compression, so writing the kmz again reuses
+ it, and adding to such a kml after that is an error until KML_reset().
+*******************************************************************************/
+
+void KMZ_set_incremental(
+	KMZ *kmz,
+	size_t highwater);
+
+/*****************************************************************************//**
+ function to have the kmls of a kmz carved from one arena
+ 
+ @param kmz					pointer to the kmz struct
+ @param chunksize		size of the first chunk of the arena, or 0 for the
+										default of 64 KB, later chunks double up to 16 MB
+
+ @return	nothing
+
+ applies to kmls created with KML_new() after this call. their structs and
+ first 4 KB of content come from the arena instead of separate malloc()s,
+ and all of it is released at once by KMZ_free(). the arena grows by adding
+ chunks, so nothing in it is ever moved. this suits kmzs with very many
+ small kmls, such as tile pyramids. a kml that outgrows its first block
+ continues in memory of its own.
+*******************************************************************************/
+
+void KMZ_set_arena(
+	KMZ *kmz,
+	size_t chunksize);
+
 /*****************************************************************************//**
  function to create a new kml
  
  @param kmz					pointer to the kmz to add it to
  @param kmlfile			the full path of the kml file
- @param printprec		the precision to print coordantes at
+ @param printprec		the precision to print coordantes at or
+										KML_PREC_SHORTEST
 
  @return	pointer to the KML struct
 *******************************************************************************/
@@ -56,17 +130,83 @@ KML *KML_new(
 	char *kmlfile,
 	int printprec);
 
+/*****************************************************************************//**
+ function to create a new kml that is written to disk as it is made
+ 
+ @param kmlfile			the full path of the kml file
+ @param printprec		the precision to print coordantes at or
+										KML_PREC_SHORTEST
+ @param highwater		the kml is written out whenever this many bytes are
+										waiting, or 0 for KML_STREAM_HIGHWATER
+
+ @return	pointer to the KML struct
+
+ the file is opened here and memory use stays around highwater no matter
+ how big the document gets. KML_write() writes what is left and closes the
+ file. a streaming kml cannot be added to a kmz.
+*******************************************************************************/
+
+KML *KML_new_stream(
+	char *kmlfile,
+	int printprec,
+	size_t highwater);
+
+/*****************************************************************************//**
+ function to empty a kml so it can be made again
+ 
+ @param kml				pointer to the kml struct
+ @param kmlfile		the full path of the kml file, or NULL to keep the one
+									it has
+ 
+ @return	nothing
+
+ the content, indenting and compression statistics are cleared, while the
+ settings and the memory the kml has grown to are kept, so a kml that is
+ made over and over does no large allocations once it is warm. a kml made
+ with KML_new_stream() truncates its file and starts writing it again.
+*******************************************************************************/
+
+void KML_reset(
+	KML *kml,
+	char *kmlfile);
+
+/*****************************************************************************//**
+ function to empty all the kmls of a kmz so they can be made again
+ 
+ @param kmz				pointer to the kmz struct
+ 
+ @return	nothing
+
+ every kml in the kmz is emptied with KML_reset(), keeping its name. the
+ kmz is then filled and written again as usual.
+*******************************************************************************/
+
+void KMZ_reset(
+	KMZ *kmz);
+
 /*****************************************************************************//**
  function to free a kml struct
  
  @param kml				pointer to the kml struct
  
  @return	nothing
+
+ up to 256 freed kmls, each with up to 16 KB of content memory, are kept
+ for KML_new() to reuse, so programs making very many small kmls do not
+ allocate for each one.
 *******************************************************************************/
 
 void KML_free(
 	KML *kml);
 
+/*****************************************************************************//**
+ function to free the kmls KML_free() keeps for reuse
+ 
+ @return	nothing
+*******************************************************************************/
+
+void KML_pool_free(void);
+
 /*****************************************************************************//**
  function to free a kmz struct
  
@@ -84,11 +224,212 @@ void KMZ_free(
  @param kmz				pointer to the kmz struct
  
  @return	nothing
+
+ two kmls with the same name are an error, the zip would hide one of them.
 *******************************************************************************/
 
 void KMZ_write(
 	KMZ *kmz);
 
+/*****************************************************************************//**
+ function to write a kmz to memory
+ 
+ @param kmz				pointer to the kmz struct
+ @param size			set to the size of the kmz
+ 
+ @return	pointer to the kmz data, the caller must free() it
+
+ the kmz is built in one block of memory without touching the disk, the
+ kmzfile given to KMZ_new() is not used.
+*******************************************************************************/
+
+char *KMZ_write_to_memory(
+	KMZ *kmz,
+	size_t *size);
+
+/*****************************************************************************//**
+ function to write a kmz to an open file descriptor
+ 
+ @param kmz				pointer to the kmz struct
+ @param fd				the file descriptor, it is left open
+ 
+ @return	nothing
+
+ the kmz is written front to back with no seeking, so fd can be a pipe,
+ a socket or stdout. each entry's crc and sizes follow its data in a zip
+ data descriptor. with KMZ_set_threads() entries go out as soon as they
+ are compressed, while later ones are still being compressed.
+*******************************************************************************/
+
+void KMZ_write_fd(
+	KMZ *kmz,
+	int fd);
+
+/*****************************************************************************//**
+ function to update a kmz on disk
+ 
+ @param kmz				pointer to the kmz struct
+ 
+ @return	nothing
+
+ each kml in the kmz replaces the entry of the same name in the existing
+ kmzfile, or is added after the other entries if there is none. all the
+ other entries are copied over still compressed, so the cost depends on
+ what changed rather than on the size of the archive. the new archive is
+ written beside the old one and renamed over it. if there is no kmzfile
+ yet this is KMZ_write(). archives with zip64 records cannot be read.
+*******************************************************************************/
+
+void KMZ_update(
+	KMZ *kmz);
+
+/*****************************************************************************//**
+ function to set the number of threads a kmz is compressed with
+ 
+ @param kmz				pointer to the kmz struct
+ @param threads		the number of threads, 1 or less for none
+ 
+ @return	nothing
+
+ with more than one thread KMZ_write() compresses the kmls side by side
+ and writes each one, in the original order, as soon as it is done.
+*******************************************************************************/
+
+void KMZ_set_threads(
+	KMZ *kmz,
+	int threads);
+
+/*****************************************************************************//**
+ function to set the size of the buffer a kmz file is written through
+ 
+ @param kmz				pointer to the kmz struct
+ @param bufsize		the size in bytes, 0 for the default of 4 MB
+ 
+ @return	nothing
+
+ KMZ_write() and KMZ_update() write the file straight to its descriptor
+ through this buffer, in blocks of this size. the header of each entry is
+ patched in the buffer, or with one pwrite() once it has gone out.
+*******************************************************************************/
+
+void KMZ_set_write_buffer(
+	KMZ *kmz,
+	size_t bufsize);
+
+/*****************************************************************************//**
+ function to set the default compression settings of the kmls in a kmz
+ 
+ @param kmz				pointer to the kmz struct
+ @param method		KML_DEFLATED, or KML_STORED
+ @param level			the zlib compression level, -1 for the default
+ @param strategy	the zlib deflate strategy, 0 for the default
+ @param memlevel	the zlib memory level, 0 for the default
+ 
+ @return	nothing
+
+ kmls made before this keep the settings they have.
+*******************************************************************************/
+
+void KMZ_set_compression(
+	KMZ *kmz,
+	int method,
+	int level,
+	int strategy,
+	int memlevel);
+
+/*****************************************************************************//**
+ function to set the compression settings of a kml
+ 
+ @param kml				pointer to the kml struct
+ @param method		KML_DEFLATED, or KML_STORED
+ @param level			the zlib compression level, -1 for the default
+ @param strategy	the zlib deflate strategy, 0 for the default
+ @param memlevel	the zlib memory level, 0 for the default
+ 
+ @return	nothing
+
+ call this right after KML_new(), a kml that is compressed as it is made
+ cannot change settings once compression has started.
+*******************************************************************************/
+
+void KML_set_compression(
+	KML *kml,
+	int method,
+	int level,
+	int strategy,
+	int memlevel);
+
+/*****************************************************************************//**
+ function to have the kmls of a kmz compressed so that rsync can find the
+ unchanged parts
+ 
+ @param kmz					pointer to the kmz struct
+ @param rsyncable		1 to turn it on, 0 to turn it off
+ 
+ @return	nothing
+
+ applies to kmls created with KML_new() after this call. like gzip
+ --rsyncable, deflate is started over at points picked by a rolling hash
+ of the kml text, about every 80 KB, so a change to one placemark only
+ changes the compressed bytes up to the next such point and rsync or zsync
+ only move that part. the kmz is usually a few percent bigger, and the kmls
+ are not split across threads.
+*******************************************************************************/
+
+void KMZ_set_rsyncable(
+	KMZ *kmz,
+	int rsyncable);
+
+/*****************************************************************************//**
+ function to have a kml compressed so that rsync can find the unchanged parts
+ 
+ @param kml					pointer to the kml struct
+ @param rsyncable		1 to turn it on, 0 to turn it off
+ 
+ @return	nothing
+
+ see KMZ_set_rsyncable(). like KML_set_compression() call it right after
+ KML_new().
+*******************************************************************************/
+
+void KML_set_rsyncable(
+	KML *kml,
+	int rsyncable);
+
+/*****************************************************************************//**
+ function to get the compression statistics of a kml after KMZ_write()
+ 
+ @param kml					pointer to the kml struct
+ @param size				set to the uncompressed size
+ @param compressed	set to the compressed size
+ @param seconds			set to the time spent compressing
+ 
+ @return	nothing
+*******************************************************************************/
+
+void KML_get_compression_stats(
+	KML *kml,
+	size_t *size,
+	size_t *compressed,
+	double *seconds);
+
+/*****************************************************************************//**
+ function to get the compression statistics of a whole kmz after KMZ_write()
+ 
+ @param kmz					pointer to the kmz struct
+ @param size				set to the total uncompressed size
+ @param compressed	set to the total compressed size
+ @param seconds			set to the total time spent compressing
+ 
+ @return	nothing
+*******************************************************************************/
+
+void KMZ_get_compression_stats(
+	KMZ *kmz,
+	size_t *size,
+	size_t *compressed,
+	double *seconds);
+
 /*****************************************************************************//**
  function to write a kml to disk
  
@@ -100,6 +441,67 @@ void KMZ_write(
 void KML_write(
 	KML *kml);
 
+/*****************************************************************************//**
+ function to set the block size of a kml
+ 
+ @param kml				pointer to the kml struct
+ @param blocksize	size of the blocks the kml is kept in, or 0 for one
+									contiguous block
+ 
+ @return	nothing
+
+ by default a kml is kept in one block that is realloc()ed as it grows,
+ which copies the document each time and needs up to 3x its size while
+ doing so. past 64 MB the block is mmap()ed and grows by remapping its
+ pages instead, where the system supports it. with a block size set the
+ kml grows by adding blocks and what is already written is never moved. a
+ block size of a few MB suits large documents.
+*******************************************************************************/
+
+void KML_set_blocksize(
+	KML *kml,
+	size_t blocksize);
+
+/*****************************************************************************//**
+ function to allocate room in a kml for what is going to be added to it
+ 
+ @param kml				pointer to the kml struct
+ @param bytes			the number of bytes expected, see KML_estimate_size()
+ 
+ @return	nothing
+
+ a kml otherwise starts small and doubles as it grows, copying itself each
+ time. a kml with a block size gets at most one block, and a streaming or
+ incrementally compressed kml at most its high water mark.
+*******************************************************************************/
+
+void KML_reserve(
+	KML *kml,
+	size_t bytes);
+
+/*****************************************************************************//**
+ function to estimate the size of a kml
+ 
+ @param placemarks	the number of placemarks
+ @param vertices		the total number of coordinate tuples
+ @param printprec		the precision the coordinates are printed at or
+										KML_PREC_SHORTEST
+ @param dims				the number of values in each tuple, 2 or 3
+
+ @return	the estimated number of bytes
+
+ the estimate errs on the high side for placemarks holding a style url and
+ one line string or ring. names, descriptions and styles are extra. it can
+ be passed to KML_reserve(), or used to choose between KML_new() and
+ KML_new_stream() for documents that may not fit in memory.
+*******************************************************************************/
+
+size_t KML_estimate_size(
+	size_t placemarks,
+	size_t vertices,
+	int printprec,
+	int dims);
+
 /*****************************************************************************//**
  function to add a kml header to a kml
  
@@ -359,6 +761,82 @@ void KML_coordinates_2d (
 	double *x,
 	double *y);
 
+/*****************************************************************************//**
+ function to add coordinates of an array of 3d points to a kml
+ 
+ @param kml					pointer to the kml struct
+ @param xyz					the points as x,y,z,x,y,z...
+ @param count				the number of points
+	
+ @return	nothing
+*******************************************************************************/
+
+void KML_coordinates_3d_array (
+	KML *kml,
+	double *xyz,
+	size_t count);
+
+/*****************************************************************************//**
+ function to add coordinates of an array of 2d points to a kml
+ 
+ @param kml					pointer to the kml struct
+ @param xy					the points as x,y,x,y...
+ @param count				the number of points
+ 
+ @return	nothing
+*******************************************************************************/
+
+void KML_coordinates_2d_array (
+	KML *kml,
+	double *xy,
+	size_t count);
+
+/*****************************************************************************//**
+ function to add coordinates of points held in separate x, y and z arrays
+ to a kml
+ 
+ @param kml					pointer to the kml struct
+ @param x						array of x coords
+ @param y						array of y coords
+ @param z						array of z coords or NULL for 2d
+ @param count				the number of points
+ 
+ @return	nothing
+*******************************************************************************/
+
+void KML_coordinates_soa (
+	KML *kml,
+	double *x,
+	double *y,
+	double *z,
+	size_t count);
+
+/*****************************************************************************//**
+ function to add coordinates of points laid out with a byte stride, such
+ as fields in an array of structs, to a kml
+ 
+ @param kml					pointer to the kml struct
+ @param x						the x coord of the first point
+ @param y						the y coord of the first point
+ @param z						the z coord of the first point or NULL for 2d
+ @param stride			the number of bytes from one point to the next
+ @param count				the number of points
+ 
+ @return	nothing
+
+ eg. for struct pt {int id; double lon, lat, alt;} pts[n];
+ KML_coordinates_strided(kml, &pts[0].lon, &pts[0].lat, &pts[0].alt,
+                         sizeof(struct pt), n);
+*******************************************************************************/
+
+void KML_coordinates_strided (
+	KML *kml,
+	double *x,
+	double *y,
+	double *z,
+	size_t stride,
+	size_t count);
+
 /*****************************************************************************//**
  function to add a style header to a kml
  
@@ -26,18 +26,43 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
 #include "../minizip/zip.h"
+#include "../minizip/iomem.h"
+#include "../minizip/iofd.h"
+#include "../minizip/iobuf.h"
+#include "../minizip/unzip.h"
 
 #include "buffer.h"
 #include "zipbuffer.h"
 #include "error.h"
 
+/***** block size for compressed data *****/
+
+#define DEFLATEBLOCK (256 * 1024)
+
+/***** rsyncable deflate restarts where the top RSYNCBITS of the rolling
+			 hash are 0, at least RSYNCMIN bytes apart, about every 80 KB *****/
+
+#define RSYNCBITS 16
+#define RSYNCMASK (((1UL << RSYNCBITS) - 1) << (32 - RSYNCBITS))
+#define RSYNCMIN (16 * 1024)
+
+/***** entries this big get zip64 local headers, with room for deflate to
+			 grow incompressible data *****/
+
+#define ZIP64SIZE 0xf0000000UL
+
 
 /*******************************************************************************
 	function to open the zip file
 	
 	args:
 						name			the filename of the zip archive
+						bufsize		size of the write buffer, 0 for the default
 
 	returns:
 						pointer to the zip structure
@@ -45,12 +70,17 @@
 *******************************************************************************/
 
 zipFile *zipbuffer_open (
-	char *name)
+	char *name,
+	size_t bufsize)
 {
 	//struct zip *result = NULL;
 	zipFile *result = NULL;
+	zlib_filefunc_def filefunc;
+	uLong size = bufsize;
+	
+	fill_buf_filefunc(&filefunc, &size);
 
-	if (!(result = zipOpen(name, APPEND_STATUS_CREATE))) {
+	if (!(result = zipOpen2(name, APPEND_STATUS_CREATE, NULL, &filefunc))) {
 	//if (!(result = zip_open(name, ZIP_CREATE, &err))) {
 		ERROR("zipbuffer_open");
 	}
@@ -58,6 +88,349 @@ zipFile *zipbuffer_open (
 	return result;
 }
 
+/*******************************************************************************
+	function to open a zip file to add entries after the ones already in it,
+	only the central directory is rewritten
+	
+	args:
+						name			the filename of the zip archive, it is created if
+											it does not exist
+						bufsize		size of the write buffer, 0 for the default
+
+	returns:
+						pointer to the zip structure
+						exit()s on error
+*******************************************************************************/
+
+zipFile *zipbuffer_open_append (
+	char *name,
+	size_t bufsize)
+{
+	zipFile *result = NULL;
+	zlib_filefunc_def filefunc;
+	uLong size = bufsize;
+	
+	if (access(name, F_OK))
+		return zipbuffer_open(name, bufsize);
+	
+	fill_buf_filefunc(&filefunc, &size);
+	
+	if (!(result = zipOpen2(name, APPEND_STATUS_ADDINZIP, NULL, &filefunc)))
+		ERROR("zipbuffer_open_append");
+	
+	return result;
+}
+
+/*******************************************************************************
+	function to open a zip in memory
+	
+	args:
+						mem				pointer to a zeroed memory struct, holds the zip
+											once it is closed
+
+	returns:
+						pointer to the zip structure
+						exit()s on error
+*******************************************************************************/
+
+zipFile *zipbuffer_open_memory (
+	ourmemory_t *mem)
+{
+	zlib_filefunc_def filefunc;
+	zipFile *result = NULL;
+	
+	fill_memory_filefunc(&filefunc, mem);
+	
+	if (!(result = zipOpen2("memory", APPEND_STATUS_CREATE, NULL, &filefunc)))
+		ERROR("zipbuffer_open_memory");
+	
+	return result;
+}
+
+/*******************************************************************************
+	function to open a zip on a file descriptor, the zip is streamed out
+	with no seeks
+	
+	args:
+						ourfd			pointer to the descriptor struct, kept until the zip
+											is closed
+
+	returns:
+						pointer to the zip structure
+						exit()s on error
+*******************************************************************************/
+
+zipFile *zipbuffer_open_fd (
+	ourfd_t *ourfd)
+{
+	zlib_filefunc_def filefunc;
+	zipFile *result = NULL;
+	
+	fill_fd_filefunc(&filefunc, ourfd);
+	
+	if (!(result = zipOpen2("fd", APPEND_STATUS_CREATESTREAM, NULL,
+													&filefunc)))
+		ERROR("zipbuffer_open_fd");
+	
+	return result;
+}
+
+/*******************************************************************************
+	function to fill in zip compression settings
+	
+	args:
+						params		pointer to the zip params struct
+						method		Z_DEFLATED, or 0 to store
+						level			the deflate level
+						strategy	the deflate strategy
+						memlevel	the deflate memory level, or 0 for the default
+
+	returns:
+						nothing
+						exit()s on an unknown method
+	
+	the rsyncable flag is left as it is
+*******************************************************************************/
+
+void zipparams_init (
+	zipparams *params,
+	int method,
+	int level,
+	int strategy,
+	int memlevel)
+{
+	
+	if (method != 0 && method != Z_DEFLATED)
+		ERROR("zipparams_init");
+	
+	params->method = method;
+	params->level = method ? level : 0;
+	params->strategy = strategy;
+	params->memlevel = memlevel ? memlevel : DEF_MEM_LEVEL;
+	
+	return;
+}
+
+/*******************************************************************************
+	random values for each byte, for the rolling hash of rsyncable deflate
+*******************************************************************************/
+
+static uLong zipgear[256];
+static pthread_once_t zipgear_once = PTHREAD_ONCE_INIT;
+
+static void zipgear_init (void)
+{
+	uLong x = 0x9e3779b9UL;
+	int i;
+	
+	/***** xorshift32, so every run gets the same table *****/
+	
+	for (i = 0 ; i < 256 ; i++) {
+		x ^= (x << 13) & 0xffffffffUL;
+		x ^= x >> 17;
+		x ^= (x << 5) & 0xffffffffUL;
+		zipgear[i] = x;
+	}
+	
+	return;
+}
+
+/*******************************************************************************
+	function to get the time in seconds, for the entry statistics
+*******************************************************************************/
+
+static double zipbuffer_now (void)
+{
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*******************************************************************************
+	function to fill in the statistics of an entry from its zip deflate struct
+*******************************************************************************/
+
+static void zipbuffer_stats (
+	zipstats *stats,
+	zipdeflate *zd)
+{
+	
+	if (stats) {
+		stats->size = zd->size;
+		stats->compressed = zd->compressed;
+		stats->seconds = zd->seconds;
+	}
+	
+	return;
+}
+
+/*******************************************************************************
+	function to report a failure to start a zip entry, a duplicate name is
+	reported as EEXIST
+*******************************************************************************/
+
+static void zipbuffer_open_error (
+	int err,
+	char *function)
+{
+	
+	if (err == ZIP_DUPLICATENAME)
+		errno = EEXIST;
+	
+	ERROR(function);
+}
+
+/*******************************************************************************
+	function to start a raw entry for the output of a zip deflate struct, the
+	text flag is the one zip.c would have set from the stream. size is the
+	uncompressed size of the entry
+*******************************************************************************/
+
+static void zipbuffer_open_raw (
+	char *name,
+	zipFile zF,
+	zipdeflate *zd,
+	size_t size)
+{
+	zip_fileinfo zipfi = {0};
+	int err;
+	
+	if (zd->params.method && zd->stream.data_type == Z_ASCII)
+		zipfi.internal_fa = Z_ASCII;
+	
+	if ((err = zipOpenNewFileInZip4(zF, name, &zipfi, NULL, 0, NULL, 0, NULL,
+																	zd->params.method, zd->params.level, 1,
+																	-MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY,
+																	NULL, 0, size >= ZIP64SIZE)))
+		zipbuffer_open_error(err, "zipbuffer_open_raw");
+	
+	return;
+}
+
+/*******************************************************************************
+	buffer_iterate function to deflate a segment into the current zip entry
+*******************************************************************************/
+
+static int zipbuffer_add_segment (
+	const char *data,
+	size_t len,
+	void *extra)
+{
+	zipFile zF = extra;
+	
+	/***** minizip takes an unsigned length *****/
+	
+	while (len > 0) {
+		unsigned chunk = len > UINT_MAX ? UINT_MAX : len;
+		
+		if (zipWriteInFileInZip(zF, data, chunk))
+			return -1;
+		
+		data += chunk;
+		len -= chunk;
+	}
+	
+	return 0;
+}
+
+/*******************************************************************************
+	zip entry writer struct, the compressed data of an entry is written
+	through this as it is made
+	
+	members:
+						name			the filename of the entry
+						zF				pointer to the zip structure
+						zd				the zip deflate struct of the entry
+						size			the uncompressed size of the entry
+						opened		flag set once the entry is started
+*******************************************************************************/
+
+typedef struct {
+	char *name;
+	zipFile zF;
+	zipdeflate *zd;
+	size_t size;
+	int opened;
+} zipentry;
+
+/*******************************************************************************
+	buffer flush function to write compressed data to the current zip entry,
+	the entry is started on the first write once deflate knows the data type
+*******************************************************************************/
+
+static int zipentry_write (
+	const char *data,
+	size_t len,
+	void *extra)
+{
+	zipentry *entry = extra;
+	
+	if (!entry->opened) {
+		zipbuffer_open_raw(entry->name, entry->zF, entry->zd, entry->size);
+		entry->opened = 1;
+	}
+	
+	return zipbuffer_add_segment(data, len, entry->zF);
+}
+
+/*******************************************************************************
+	function to add a contiguous buffer to the zip file, deflated in one call
+	into output sized with deflateBound()
+	
+	returns:
+						0 on success
+						-1 if the output could be too big for one call
+						exit()s on error
+*******************************************************************************/
+
+static int zipbuffer_add_whole (
+	char *name,
+	zipFile zF,
+	buffer *buf,
+	zipparams *params,
+	zipstats *stats)
+{
+	zipdeflate zd;
+	uLong bound;
+	double start;
+	
+	zipdeflate_init(&zd, params);
+	start = zipbuffer_now();
+	
+	/***** zlib takes unsigned lengths *****/
+	
+	if (buf->used > UINT_MAX ||
+			(bound = deflateBound(&(zd.stream), buf->used)) > UINT_MAX) {
+		zipdeflate_free(&zd);
+		return -1;
+	}
+	
+	buffer_alloc(&(zd.out), bound);
+	
+	zd.stream.next_in = (Bytef *) buf->buf;
+	zd.stream.avail_in = buf->used;
+	zd.stream.next_out = (Bytef *) zd.out.buf;
+	zd.stream.avail_out = bound;
+	
+	if (Z_STREAM_END != deflate(&(zd.stream), Z_FINISH))
+		ERROR("zipbuffer_add_whole");
+	
+	if (buf->crcon)
+		zd.crc = buffer_crc(buf);
+	else
+		zd.crc = crc32(zd.crc, (const Bytef *) buf->buf, buf->used);
+	zd.size = buf->used;
+	zd.out.used = zd.compressed = zd.stream.total_out;
+	zd.seconds = zipbuffer_now() - start;
+	
+	zipbuffer_add_deflated(name, zF, &zd, stats);
+	zipdeflate_free(&zd);
+	
+	return 0;
+}
+
 /*******************************************************************************
 	function to add the buffer to the zip file
 	
@@ -65,31 +438,725 @@ zipFile *zipbuffer_open (
 						name			the filename of the file to add to the zip archive
 						zip				pointer to the zip structure
 						buf				the buffer to add
+						params		the compression settings
+						stats			filled in with the entry statistics, or NULL
 
 	returns:
 						nothing
+						exit()s on error
 *******************************************************************************/
 
 void zipbuffer_add (
 	char *name,
 	zipFile zF,
-	buffer *buf)
+	buffer *buf,
+	zipparams *params,
+	zipstats *stats)
 {
 #warning fixme i need info
 	zip_fileinfo zipfi = {};
-	if (zipOpenNewFileInZip(zF, name, &zipfi, NULL, 0, NULL, 0, NULL, Z_DEFLATED,
-													 Z_DEFAULT_COMPRESSION))
+	zipdeflate zd;
+	zipentry entry = {name, zF, &zd, buffer_length(buf), 0};
+	int err;
+	
+	/***** stored entries are copied straight in by minizip, raw when the
+				 buffer already has the crc *****/
+	
+	if (!params->method) {
+		double start = zipbuffer_now();
+		
+		if ((err = zipOpenNewFileInZip4(zF, name, &zipfi, NULL, 0, NULL, 0, NULL,
+																		0, 0, buf->crcon,
+																		-MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY,
+																		NULL, 0, entry.size >= ZIP64SIZE)))
+			zipbuffer_open_error(err, "zipbuffer_add");
+		
+		if (buffer_iterate(buf, zipbuffer_add_segment, zF))
+			ERROR("zipbuffer_add");
+		
+		if (buf->crcon)
+			err = zipCloseFileInZipRaw(zF, entry.size, buffer_crc(buf));
+		else
+			err = zipCloseFileInZip(zF);
+		
+		if (err)
+			ERROR("zipbuffer_add");
+		
+		if (stats) {
+			stats->size = stats->compressed = buffer_length(buf);
+			stats->seconds = zipbuffer_now() - start;
+		}
+		
+		return;
+	}
+	
+	/***** a buffer in one piece needs no streaming *****/
+	
+	if (!buf->head && !params->rsyncable &&
+			!zipbuffer_add_whole(name, zF, buf, params, stats))
+		return;
+	
+	/***** deflate here and write the output raw as it fills up *****/
+	
+	zipdeflate_init(&zd, params);
+	buffer_set_flush(&(zd.out), zipentry_write, &entry, DEFLATEBLOCK);
+	zd.nocrc = buf->crcon;
+	
+	if (buffer_iterate(buf, zipdeflate_write, &zd))
 		ERROR("zipbuffer_add");
 	
+	zipdeflate_finish(&zd);
+	buffer_flush(&(zd.out));
 	
-	if (ZEXPORT zipWriteInFileInZip(zF, buf->buf, buf->used)) {
+	if (zd.nocrc)
+		zd.crc = buffer_crc(buf);
+	
+	if (zipCloseFileInZipRaw(zF, zd.size, zd.crc))
 		ERROR("zipbuffer_add");
+	
+	zipbuffer_stats(stats, &zd);
+	zipdeflate_free(&zd);
+	
+	return;
+}
+
+/*******************************************************************************
+	function to start compressing an entry ahead of writing the zip
+	
+	args:
+						zd				pointer to the zip deflate struct
+						params		the compression settings
+
+	returns:
+						nothing
+						exit()s on error
+*******************************************************************************/
+
+void zipdeflate_init (
+	zipdeflate *zd,
+	zipparams *params)
+{
+	
+	memset(zd, 0, sizeof(zipdeflate));
+	zd->params = *params;
+	zd->crc = crc32(0L, Z_NULL, 0);
+	
+	buffer_set_segsize(&(zd->out), DEFLATEBLOCK);
+	
+	/***** stored entries are only copied *****/
+	
+	if (!params->method)
+		return;
+	
+	if (params->rsyncable)
+		pthread_once(&zipgear_once, zipgear_init);
+	
+	/***** raw deflate, the zip headers are made by minizip *****/
+	
+	if (Z_OK != deflateInit2(&(zd->stream), params->level, Z_DEFLATED,
+													 -MAX_WBITS, params->memlevel, params->strategy))
+		ERROR("zipdeflate_init");
+	
+	return;
+}
+
+/*******************************************************************************
+	function to run deflate until it has taken all its input, or finished
+*******************************************************************************/
+
+static int zipdeflate_run (
+	zipdeflate *zd,
+	int flush)
+{
+	buffer *out = &(zd->out);
+	int result;
+	
+	do {
+		size_t used;
+		
+		if (out->alloced < out->used + 1024)
+			buffer_alloc(out, DEFLATEBLOCK / 4);
+		
+		zd->stream.next_out = (Bytef *) (out->buf + out->used);
+		zd->stream.avail_out = out->alloced - out->used;
+		
+		result = deflate(&(zd->stream), flush);
+		
+		used = (char *) zd->stream.next_out - out->buf;
+		zd->compressed += used - out->used;
+		out->used = used;
+		
+		if (result == Z_STREAM_ERROR)
+			return -1;
+		
+	} while (zd->stream.avail_in > 0 ||
+					 (flush == Z_FINISH && result != Z_STREAM_END) ||
+					 (flush != Z_NO_FLUSH && zd->stream.avail_out == 0));
+	
+	return 0;
+}
+
+/*******************************************************************************
+	function to compress more data for rsyncable params. a gear hash rolls
+	over the input, and where its top bits are 0 deflate is fully flushed,
+	which starts it over with no history. a change in the input then only
+	changes the output up to the next such boundary
+*******************************************************************************/
+
+static int zipdeflate_rsync (
+	zipdeflate *zd,
+	const char *data,
+	unsigned len)
+{
+	const unsigned char *in = (const unsigned char *) data;
+	unsigned start = 0;
+	unsigned i;
+	
+	for (i = 0 ; i < len ; i++) {
+		zd->rsynchash = ((zd->rsynchash << 1) + zipgear[in[i]]) & 0xffffffffUL;
+		zd->rsyncsince++;
+		
+		if (zd->rsyncsince >= RSYNCMIN && !(zd->rsynchash & RSYNCMASK)) {
+			zd->stream.next_in = (Bytef *) data + start;
+			zd->stream.avail_in = i + 1 - start;
+			
+			if (zipdeflate_run(zd, Z_FULL_FLUSH))
+				return -1;
+			
+			start = i + 1;
+			zd->rsyncsince = 0;
+		}
 	}
 	
-	if (zipCloseFileInZip(zF)) {
-		ERROR("zipbuffer_add");
+	zd->stream.next_in = (Bytef *) data + start;
+	zd->stream.avail_in = len - start;
+	
+	return zipdeflate_run(zd, Z_NO_FLUSH);
+}
+
+/*******************************************************************************
+	function to compress more data, usable as a buffer flush function
+	
+	args:
+						data			the data to compress
+						len				the length of the data
+						extra			pointer to the zip deflate struct
+
+	returns:
+						0 on success
+						-1 on error
+*******************************************************************************/
+
+int zipdeflate_write (
+	const char *data,
+	size_t len,
+	void *extra)
+{
+	zipdeflate *zd = extra;
+	double start = zipbuffer_now();
+	
+	/***** nothing more goes into a finished entry *****/
+	
+	if (zd->finished && len > 0)
+		return -1;
+	
+	/***** zlib takes an unsigned length *****/
+	
+	while (len > 0) {
+		unsigned chunk = len > UINT_MAX ? UINT_MAX : len;
+		
+		if (!zd->nocrc)
+			zd->crc = crc32(zd->crc, (const Bytef *) data, chunk);
+		zd->size += chunk;
+		
+		if (!zd->params.method) {
+			buffer_append_noindent(&(zd->out), data, chunk);
+			zd->compressed += chunk;
+		}
+		
+		else if (zd->params.rsyncable) {
+			if (zipdeflate_rsync(zd, data, chunk))
+				return -1;
+		}
+		
+		else {
+			zd->stream.next_in = (Bytef *) data;
+			zd->stream.avail_in = chunk;
+			
+			if (zipdeflate_run(zd, Z_NO_FLUSH))
+				return -1;
+		}
+		
+		data += chunk;
+		len -= chunk;
 	}
 	
+	zd->seconds += zipbuffer_now() - start;
+	
+	return 0;
+}
+
+/*******************************************************************************
+	function to finish compressing an entry
+	
+	args:
+						zd				pointer to the zip deflate struct
+
+	returns:
+						nothing
+						exit()s on error
+	
+	finishing an entry again does nothing, its output is kept as it is
+*******************************************************************************/
+
+void zipdeflate_finish (
+	zipdeflate *zd)
+{
+	double start = zipbuffer_now();
+	
+	if (zd->finished)
+		return;
+	
+	zd->finished = 1;
+	
+	if (!zd->params.method)
+		return;
+	
+	zd->stream.avail_in = 0;
+	
+	if (zipdeflate_run(zd, Z_FINISH))
+		ERROR("zipdeflate_finish");
+	
+	deflateEnd(&(zd->stream));
+	
+	zd->seconds += zipbuffer_now() - start;
+	
+	return;
+}
+
+/*******************************************************************************
+	function to start a zip deflate struct over for a new entry with the same
+	settings, keeping the memory of its output buffer
+	
+	args:
+						zd				pointer to the zip deflate struct
+
+	returns:
+						nothing
+						exit()s on error
+*******************************************************************************/
+
+void zipdeflate_reset (
+	zipdeflate *zd)
+{
+	buffer out = zd->out;
+	zipparams params = zd->params;
+	int nocrc = zd->nocrc;
+	
+	/***** a finished stream has already been ended *****/
+	
+	deflateEnd(&(zd->stream));
+	
+	zipdeflate_init(zd, &params);
+	
+	buffer_reset(&out);
+	zd->out = out;
+	zd->nocrc = nocrc;
+	
+	return;
+}
+
+/*******************************************************************************
+	function to free a zip deflate struct
+	
+	args:
+						zd				pointer to the zip deflate struct
+
+	returns:
+						nothing
+*******************************************************************************/
+
+void zipdeflate_free (
+	zipdeflate *zd)
+{
+	
+	deflateEnd(&(zd->stream));
+	buffer_free(&(zd->out));
+	
+	return;
+}
+
+/*******************************************************************************
+	function to add an already compressed entry to the zip file
+	
+	args:
+						name			the filename of the file to add to the zip archive
+						zip				pointer to the zip structure
+						zd				the finished zip deflate struct
+						stats			filled in with the entry statistics, or NULL
+
+	returns:
+						nothing
+*******************************************************************************/
+
+void zipbuffer_add_deflated (
+	char *name,
+	zipFile zF,
+	zipdeflate *zd,
+	zipstats *stats)
+{
+	
+	zipbuffer_open_raw(name, zF, zd, zd->size);
+	
+	if (buffer_iterate(&(zd->out), zipbuffer_add_segment, zF))
+		ERROR("zipbuffer_add_deflated");
+	
+	if (zipCloseFileInZipRaw(zF, zd->size, zd->crc))
+		ERROR("zipbuffer_add_deflated");
+	
+	zipbuffer_stats(stats, zd);
+	
+	return;
+}
+
+/*******************************************************************************
+	parallel deflate job struct
+	
+	members:
+						data			the start of each input block
+						len				the length of each input block
+						zds				the compressed blocks
+						done			flag for each block, set when it is compressed
+						count			the number of blocks
+						next			the next block to compress
+						params		the compression settings
+						lock			lock for next and done
+						cond			signaled when a block is done
+*******************************************************************************/
+
+typedef struct {
+	const char **data;
+	size_t *len;
+	zipdeflate *zds;
+	int *done;
+	int count;
+	int next;
+	zipparams *params;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} zipjob;
+
+/*******************************************************************************
+	buffer_iterate function to cut a buffer into input blocks, blocks do not
+	cross segments
+*******************************************************************************/
+
+static int zipjob_iterate (
+	const char *data,
+	size_t len,
+	void *extra)
+{
+	zipjob *job = extra;
+	
+	while (len > 0) {
+		size_t chunk = len > ZIPBLOCK ? ZIPBLOCK : len;
+		
+		if (job->data) {
+			job->data[job->count] = data;
+			job->len[job->count] = chunk;
+		}
+		job->count++;
+		
+		data += chunk;
+		len -= chunk;
+	}
+	
+	return 0;
+}
+
+/*******************************************************************************
+	function to compress one block, primed with the 32k of input before it.
+	every block but the last ends on a sync flush so the blocks can simply be
+	joined
+*******************************************************************************/
+
+static void zipjob_deflate (
+	zipjob *job,
+	int i)
+{
+	zipdeflate *zd = job->zds + i;
+	unsigned char dict[32768];
+	size_t dictlen = 0;
+	int j;
+	
+	zipdeflate_init(zd, job->params);
+	
+	/***** the dictionary may span several earlier blocks *****/
+	
+	for (j = i - 1 ; j >= 0 && dictlen < sizeof(dict) ; j--) {
+		size_t want = sizeof(dict) - dictlen;
+		size_t take = job->len[j] < want ? job->len[j] : want;
+		
+		memcpy(dict + sizeof(dict) - dictlen - take,
+					 job->data[j] + job->len[j] - take, take);
+		dictlen += take;
+	}
+	
+	if (dictlen && Z_OK != deflateSetDictionary(&(zd->stream),
+																dict + sizeof(dict) - dictlen, dictlen))
+		ERROR("zipjob_deflate");
+	
+	if (zipdeflate_write(job->data[i], job->len[i], zd))
+		ERROR("zipjob_deflate");
+	
+	if (i == job->count - 1)
+		zipdeflate_finish(zd);
+	
+	else {
+		if (zipdeflate_run(zd, Z_SYNC_FLUSH))
+			ERROR("zipjob_deflate");
+		
+		deflateEnd(&(zd->stream));
+	}
+	
+	return;
+}
+
+/*******************************************************************************
+	worker thread function to compress the blocks of a job
+*******************************************************************************/
+
+static void *zipjob_worker (
+	void *arg)
+{
+	zipjob *job = arg;
+	
+	while (1) {
+		int i;
+		
+		pthread_mutex_lock(&job->lock);
+		i = job->next++;
+		pthread_mutex_unlock(&job->lock);
+		
+		if (i >= job->count)
+			break;
+		
+		zipjob_deflate(job, i);
+		
+		pthread_mutex_lock(&job->lock);
+		job->done[i] = 1;
+		pthread_cond_broadcast(&job->cond);
+		pthread_mutex_unlock(&job->lock);
+	}
+	
+	return NULL;
+}
+
+/*******************************************************************************
+	function to add the buffer to the zip file, splitting it into blocks that
+	are deflated on several threads and joined into one deflate stream
+	
+	args:
+						name			the filename of the file to add to the zip archive
+						zip				pointer to the zip structure
+						buf				the buffer to add
+						params		the compression settings
+						threads		the number of threads to deflate with
+						stats			filled in with the entry statistics, or NULL
+
+	returns:
+						nothing
+						exit()s on error
+*******************************************************************************/
+
+void zipbuffer_add_parallel (
+	char *name,
+	zipFile zF,
+	buffer *buf,
+	zipparams *params,
+	int threads,
+	zipstats *stats)
+{
+	zipjob job = {0};
+	zipdeflate total = {0};
+	pthread_t *tids;
+	int i;
+	
+	buffer_iterate(buf, zipjob_iterate, &job);
+	
+	/***** rsyncable entries restart where the content says, not per block *****/
+	
+	if (job.count < 2 || threads < 2 || !params->method || params->rsyncable) {
+		zipbuffer_add(name, zF, buf, params, stats);
+		return;
+	}
+	
+	if (!(job.data = calloc(job.count, sizeof(char *))) ||
+			!(job.len = calloc(job.count, sizeof(size_t))) ||
+			!(job.zds = calloc(job.count, sizeof(zipdeflate))) ||
+			!(job.done = calloc(job.count, sizeof(int))))
+		ERROR("zipbuffer_add_parallel");
+	
+	job.count = 0;
+	job.params = params;
+	buffer_iterate(buf, zipjob_iterate, &job);
+	
+	pthread_mutex_init(&job.lock, NULL);
+	pthread_cond_init(&job.cond, NULL);
+	
+	if (threads > job.count)
+		threads = job.count;
+	
+	if (!(tids = calloc(threads, sizeof(pthread_t))))
+		ERROR("zipbuffer_add_parallel");
+	
+	for (i = 0 ; i < threads ; i++) {
+		if (pthread_create(tids + i, NULL, zipjob_worker, &job))
+			ERROR("zipbuffer_add_parallel");
+	}
+	
+	/***** write the blocks in order as they finish *****/
+	
+	for (i = 0 ; i < job.count ; i++) {
+		zipdeflate *zd = job.zds + i;
+		
+		pthread_mutex_lock(&job.lock);
+		while (!job.done[i])
+			pthread_cond_wait(&job.cond, &job.lock);
+		pthread_mutex_unlock(&job.lock);
+		
+		if (i == 0)
+			zipbuffer_open_raw(name, zF, zd, buffer_length(buf));
+		
+		if (buffer_iterate(&(zd->out), zipbuffer_add_segment, zF))
+			ERROR("zipbuffer_add_parallel");
+		
+		/***** the totals are kept in a zip deflate struct of their own *****/
+		
+		total.crc = i ? crc32_combine(total.crc, zd->crc, zd->size) : zd->crc;
+		total.size += zd->size;
+		total.compressed += zd->compressed;
+		total.seconds += zd->seconds;
+		
+		zipdeflate_free(zd);
+	}
+	
+	if (zipCloseFileInZipRaw(zF, total.size, total.crc))
+		ERROR("zipbuffer_add_parallel");
+	
+	zipbuffer_stats(stats, &total);
+	
+	for (i = 0 ; i < threads ; i++)
+		pthread_join(tids[i], NULL);
+	
+	pthread_cond_destroy(&job.cond);
+	pthread_mutex_destroy(&job.lock);
+	
+	free(tids);
+	free(job.done);
+	free(job.zds);
+	free(job.len);
+	free(job.data);
+	
+	return;
+}
+
+/*******************************************************************************
+	function to copy the current entry of an unzip file into the zip file,
+	without decompressing it
+	
+	args:
+						uF				pointer to the unzip structure
+						zF				pointer to the zip structure
+
+	returns:
+						nothing
+						exit()s on error
+*******************************************************************************/
+
+void zipbuffer_copy_raw (
+	unzFile uF,
+	zipFile zF)
+{
+	unz_file_info info;
+	zip_fileinfo zipfi = {0};
+	char *name, *extra, *comment;
+	char buf[DEFLATEBLOCK / 4];
+	int method, level, len;
+	int err;
+	
+	if (UNZ_OK != unzGetCurrentFileInfo(uF, &info, NULL, 0, NULL, 0, NULL, 0))
+		ERROR("zipbuffer_copy_raw");
+	
+	if (!(name = malloc(info.size_filename + 1)) ||
+			!(extra = malloc(info.size_file_extra + 1)) ||
+			!(comment = malloc(info.size_file_comment + 1)))
+		ERROR("zipbuffer_copy_raw");
+	
+	if (UNZ_OK != unzGetCurrentFileInfo(uF, &info,
+																			name, info.size_filename + 1,
+																			extra, info.size_file_extra,
+																			comment, info.size_file_comment + 1))
+		ERROR("zipbuffer_copy_raw");
+	
+	zipfi.dosDate = info.dosDate;
+	zipfi.internal_fa = info.internal_fa;
+	zipfi.external_fa = info.external_fa;
+	
+	/***** raw on both sides, the compressed data is copied as it is *****/
+	
+	if (UNZ_OK != unzOpenCurrentFile2(uF, &method, &level, 1))
+		ERROR("zipbuffer_copy_raw");
+	
+	if ((err = zipOpenNewFileInZip4(zF, name, &zipfi, NULL, 0,
+																	extra, info.size_file_extra,
+																	info.size_file_comment ? comment : NULL,
+																	method, level, 1,
+																	-MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY,
+																	NULL, 0, info.uncompressed_size >= ZIP64SIZE)))
+		zipbuffer_open_error(err, "zipbuffer_copy_raw");
+	
+	while (0 < (len = unzReadCurrentFile(uF, buf, sizeof(buf)))) {
+		if (zipWriteInFileInZip(zF, buf, len))
+			ERROR("zipbuffer_copy_raw");
+	}
+	
+	if (len < 0)
+		ERROR("zipbuffer_copy_raw");
+	
+	if (zipCloseFileInZipRaw(zF, info.uncompressed_size, info.crc))
+		ERROR("zipbuffer_copy_raw");
+	
+	unzCloseCurrentFile(uF);
+	
+	free(comment);
+	free(extra);
+	free(name);
+	
+	return;
+}
+
+/*******************************************************************************
+	function to tell the zip file how many entries are going to be added, so
+	its central directory is allocated once
+	
+	args:
+						zF				pointer to the zip structure
+						entries		the number of entries
+
+	returns:
+						nothing
+						exit()s on error
+*******************************************************************************/
+
+void zipbuffer_reserve (
+	zipFile zF,
+	size_t entries)
+{
+	
+	if (zipReserveEntries(zF, entries))
+		ERROR("zipbuffer_reserve");
+	
 	return;
 }
 
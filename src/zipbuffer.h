@@ -17,11 +17,85 @@
 #ifndef _ZIPBUFFER_H
 #define _ZIPBUFFER_H
 
+/*******************************************************************************
+	zip compression settings structure
+	
+	members:
+							method		Z_DEFLATED, or 0 to store
+							level			the deflate level
+							strategy	the deflate strategy
+							memlevel	the deflate memory level
+							rsyncable	flag to restart deflate at boundaries picked by the
+												content, so unchanged runs of input compress to the
+												same bytes
+*******************************************************************************/
+
+typedef struct {
+	int method;
+	int level;
+	int strategy;
+	int memlevel;
+	int rsyncable;
+} zipparams;
+
+/*******************************************************************************
+	zip entry statistics structure
+	
+	members:
+							size				size of the uncompressed data
+							compressed	size of the compressed data
+							seconds			time spent compressing
+*******************************************************************************/
+
+typedef struct {
+	size_t size;
+	size_t compressed;
+	double seconds;
+} zipstats;
+
+/*******************************************************************************
+	zip deflate structure, an entry compressed ahead of writing the zip
+	
+	members:
+							stream			the zlib stream
+							out					the compressed data
+							crc					crc32 of the uncompressed data
+							size				size of the uncompressed data
+							compressed	size of the compressed data
+							seconds			time spent compressing
+							params			the compression settings
+							nocrc			flag set when the crc comes from the input buffer,
+												zipdeflate_write() then leaves crc alone
+							rsynchash	rolling hash of the input, for rsyncable params
+							rsyncsince	bytes of input since the last restart
+							finished		flag set once zipdeflate_finish() has ended the
+												stream, the output is then complete
+*******************************************************************************/
+
+typedef struct {
+	z_stream stream;
+	buffer out;
+	uLong crc;
+	size_t size;
+	size_t compressed;
+	double seconds;
+	zipparams params;
+	int nocrc;
+	uLong rsynchash;
+	size_t rsyncsince;
+	int finished;
+} zipdeflate;
+
+/***** input block size for splitting one entry across threads *****/
+
+#define ZIPBLOCK (128 * 1024)
+
 /*******************************************************************************
 	function to open the zip file
 	
 	args:
 						name			the filename of the zip archive
+						bufsize		size of the write buffer, 0 for the default
 
 	returns:
 						pointer to the zip structure
@@ -29,7 +103,81 @@
 *******************************************************************************/
 
 zipFile *zipbuffer_open (
-	char *name);
+	char *name,
+	size_t bufsize);
+
+/*******************************************************************************
+	function to open a zip file to add entries after the ones already in it,
+	only the central directory is rewritten
+	
+	args:
+						name			the filename of the zip archive, it is created if
+											it does not exist
+						bufsize		size of the write buffer, 0 for the default
+
+	returns:
+						pointer to the zip structure
+						exit()s on error
+*******************************************************************************/
+
+zipFile *zipbuffer_open_append (
+	char *name,
+	size_t bufsize);
+
+/*******************************************************************************
+	function to open a zip in memory
+	
+	args:
+						mem				pointer to a zeroed memory struct, holds the zip
+											once it is closed
+
+	returns:
+						pointer to the zip structure
+						exit()s on error
+*******************************************************************************/
+
+zipFile *zipbuffer_open_memory (
+	ourmemory_t *mem);
+
+/*******************************************************************************
+	function to open a zip on a file descriptor, the zip is streamed out
+	with no seeks
+	
+	args:
+						ourfd			pointer to the descriptor struct, kept until the zip
+											is closed
+
+	returns:
+						pointer to the zip structure
+						exit()s on error
+*******************************************************************************/
+
+zipFile *zipbuffer_open_fd (
+	ourfd_t *ourfd);
+
+/*******************************************************************************
+	function to fill in zip compression settings
+	
+	args:
+						params		pointer to the zip params struct
+						method		Z_DEFLATED, or 0 to store
+						level			the deflate level
+						strategy	the deflate strategy
+						memlevel	the deflate memory level, or 0 for the default
+
+	returns:
+						nothing
+						exit()s on an unknown method
+	
+	the rsyncable flag is left as it is
+*******************************************************************************/
+
+void zipparams_init (
+	zipparams *params,
+	int method,
+	int level,
+	int strategy,
+	int memlevel);
 
 /*******************************************************************************
 	function to add the buffer to the zip file
@@ -38,16 +186,177 @@ zipFile *zipbuffer_open (
 						name			the filename of the file to add to the zip archive
 						zip				pointer to the zip structure
 						buf				the buffer to add
+						params		the compression settings
+						stats			filled in with the entry statistics, or NULL
 
 	returns:
 						nothing
+						exit()s on error
 *******************************************************************************/
 
 void zipbuffer_add (
 	char *name,
 	zipFile zF,
-	buffer *buf);
+	buffer *buf,
+	zipparams *params,
+	zipstats *stats);
+
+/*******************************************************************************
+	function to add the buffer to the zip file, splitting it into blocks that
+	are deflated on several threads and joined into one deflate stream
+	
+	args:
+						name			the filename of the file to add to the zip archive
+						zip				pointer to the zip structure
+						buf				the buffer to add
+						params		the compression settings
+						threads		the number of threads to deflate with
+						stats			filled in with the entry statistics, or NULL
+
+	returns:
+						nothing
+						exit()s on error
+*******************************************************************************/
+
+void zipbuffer_add_parallel (
+	char *name,
+	zipFile zF,
+	buffer *buf,
+	zipparams *params,
+	int threads,
+	zipstats *stats);
+
+
+/*******************************************************************************
+	function to start compressing an entry ahead of writing the zip
+	
+	args:
+						zd				pointer to the zip deflate struct
+						params		the compression settings
+
+	returns:
+						nothing
+						exit()s on error
+*******************************************************************************/
+
+void zipdeflate_init (
+	zipdeflate *zd,
+	zipparams *params);
+
+/*******************************************************************************
+	function to compress more data, usable as a buffer flush function
+	
+	args:
+						data			the data to compress
+						len				the length of the data
+						extra			pointer to the zip deflate struct
+
+	returns:
+						0 on success
+						-1 on error
+*******************************************************************************/
+
+int zipdeflate_write (
+	const char *data,
+	size_t len,
+	void *extra);
+
+/*******************************************************************************
+	function to finish compressing an entry
+	
+	args:
+						zd				pointer to the zip deflate struct
+
+	returns:
+						nothing
+						exit()s on error
+	
+	finishing an entry again does nothing, its output is kept as it is
+*******************************************************************************/
+
+void zipdeflate_finish (
+	zipdeflate *zd);
+
+/*******************************************************************************
+	function to start a zip deflate struct over for a new entry with the same
+	settings, keeping the memory of its output buffer
+	
+	args:
+						zd				pointer to the zip deflate struct
+
+	returns:
+						nothing
+						exit()s on error
+*******************************************************************************/
+
+void zipdeflate_reset (
+	zipdeflate *zd);
+
+/*******************************************************************************
+	function to free a zip deflate struct
+	
+	args:
+						zd				pointer to the zip deflate struct
+
+	returns:
+						nothing
+*******************************************************************************/
+
+void zipdeflate_free (
+	zipdeflate *zd);
+
+/*******************************************************************************
+	function to add an already compressed entry to the zip file
+	
+	args:
+						name			the filename of the file to add to the zip archive
+						zip				pointer to the zip structure
+						zd				the finished zip deflate struct
+						stats			filled in with the entry statistics, or NULL
+
+	returns:
+						nothing
+*******************************************************************************/
+
+void zipbuffer_add_deflated (
+	char *name,
+	zipFile zF,
+	zipdeflate *zd,
+	zipstats *stats);
 
+/*******************************************************************************
+	function to copy the current entry of an unzip file into the zip file,
+	without decompressing it
+	
+	args:
+						uF				pointer to the unzip structure
+						zF				pointer to the zip structure
+
+	returns:
+						nothing
+						exit()s on error
+*******************************************************************************/
+
+void zipbuffer_copy_raw (
+	unzFile uF,
+	zipFile zF);
+
+/*******************************************************************************
+	function to tell the zip file how many entries are going to be added, so
+	its central directory is allocated once
+	
+	args:
+						zF				pointer to the zip structure
+						entries		the number of entries
+
+	returns:
+						nothing
+						exit()s on error
+*******************************************************************************/
+
+void zipbuffer_reserve (
+	zipFile zF,
+	size_t entries);
 
 /*******************************************************************************
 	function to close the zip file